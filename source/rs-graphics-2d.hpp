@@ -2,5 +2,7 @@
 
 #include "rs-graphics-2d/font.hpp"
 #include "rs-graphics-2d/image.hpp"
+#include "rs-graphics-2d/image-pyramid.hpp"
+#include "rs-graphics-2d/label-index.hpp"
 #include "rs-graphics-2d/projection.hpp"
 #include "rs-graphics-2d/version.hpp"
@@ -4,10 +4,19 @@
 #include "rs-tl/enum.hpp"
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
 #include <iterator>
+#include <limits>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
 #include <utility>
 
 #ifdef _MSC_VER
@@ -30,6 +39,11 @@
 
 #ifdef _WIN32
     #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
 #endif
 
 using namespace RS::Format;
@@ -54,6 +68,7 @@ namespace RS::Graphics::Plane {
 
         struct FontCoreInfo {
             stbtt_fontinfo info;
+            size_t data_size; // Size of the whole font file
             std::string family;
             std::string subfamily;
             std::string name;
@@ -63,6 +78,20 @@ namespace RS::Graphics::Plane {
             float units_per_em; // Font native units per em
         };
 
+        // Signed distance field glyphs are generated once per font at a fixed
+        // reference size, and resampled to the size of each ScaledFont that
+        // uses them.
+
+        constexpr float sdf_em_pixels = 64;
+        constexpr int sdf_padding = 4;
+        constexpr unsigned char sdf_edge_value = 128;
+        constexpr float sdf_pixel_distance = 32; // Field value change per reference pixel
+
+        struct SdfGlyph {
+            Detail::ByteMask field;
+            Point offset; // Top left of field relative to the glyph's reference point
+        };
+
         struct FontNameParams {
             int platform;
             int encoding;
@@ -141,18 +170,47 @@ namespace RS::Graphics::Plane {
 
         }
 
-        void free_stb_bitmap(unsigned char* ptr) noexcept {
-            if (ptr != nullptr)
-                stbtt_FreeBitmap(ptr, nullptr);
+        float sample_sdf(const Detail::ByteMask& field, float x, float y) noexcept {
+            float fx = std::floor(x);
+            float fy = std::floor(y);
+            int ix = int(fx);
+            int iy = int(fy);
+            float dx = x - fx;
+            float dy = y - fy;
+            auto at = [&field] (int x, int y) {
+                if (x < 0 || y < 0 || x >= field.shape().x() || y >= field.shape().y())
+                    return 0.0f;
+                return float(field[{x, y}]);
+            };
+            float top = (1 - dx) * at(ix, iy) + dx * at(ix + 1, iy);
+            float bottom = (1 - dx) * at(ix, iy + 1) + dx * at(ix + 1, iy + 1);
+            return (1 - dy) * top + dy * bottom;
         }
 
-        size_t get_file_size(Cstdio& io) noexcept {
-            if (! io.is_open())
-                return 0;
-            io.seek(0, SEEK_END);
-            auto size = size_t(io.tell());
-            io.seek(0, SEEK_SET);
-            return size;
+        // Fill a glyph mask from a reference SDF glyph. The ratio is the
+        // target scale divided by the reference scale, and the origin is the
+        // position of the mask's top left corner relative to the glyph's
+        // reference point.
+
+        void render_from_sdf(const SdfGlyph& sdf, Float2 ratio, float shift_x, Point origin, Detail::ByteMask& mask) noexcept {
+
+            float distance_scale = (ratio.x() + ratio.y()) / (2 * sdf_pixel_distance);
+            Point shape = mask.shape();
+
+            for (int y = 0; y < shape.y(); ++y) {
+
+                float sy = (float(origin.y() + y) + 0.5f) / ratio.y() - float(sdf.offset.y()) - 0.5f;
+                auto out = &mask[{0, y}];
+
+                for (int x = 0; x < shape.x(); ++x, ++out) {
+                    float sx = (float(origin.x() + x) + 0.5f - shift_x) / ratio.x() - float(sdf.offset.x()) - 0.5f;
+                    float distance = (sample_sdf(sdf.field, sx, sy) - float(sdf_edge_value)) * distance_scale;
+                    float t = std::clamp(distance + 0.5f, 0.0f, 1.0f);
+                    *out = uint8_t(std::lround(255 * t * t * (3 - 2 * t)));
+                }
+
+            }
+
         }
 
         bool decode_utf16_be(std::string raw, std::u32string& utf32) {
@@ -233,80 +291,406 @@ namespace RS::Graphics::Plane {
             stbtt_GetFontBoundingBox(&font.info, &x0, &y0, &x1, &y1);
         }
 
-        bool init_font(FontCoreInfo& font, const unsigned char* data, size_t offset) {
+        bool init_font(FontCoreInfo& font, const unsigned char* data, size_t size, size_t offset) {
             if (! stbtt_InitFont(&font.info, data, offset))
                 return false;
+            font.data_size = size;
             init_font_names(font);
             init_font_metrics(font);
             return true;
         }
 
         template <typename T>
-        T read_be(Cstdio& io) {
-            std::string buf = io.reads(sizeof(T));
-            std::reverse(buf.begin(), buf.end());
+        T get_be(const unsigned char* ptr) noexcept {
             T t = 0;
-            std::memcpy(&t, buf.data(), buf.size());
+            for (size_t i = 0; i < sizeof(T); ++i)
+                t = T((t << 8) | ptr[i]);
             return t;
         }
 
-        bool verify_ttf(Cstdio& io, size_t base_offset, size_t file_size) noexcept {
-            if (file_size == IO::npos)
-                file_size = get_file_size(io);
-            size_t ttf_size = file_size - base_offset;
-            if (ttf_size < 12)
+        bool verify_ttf(const unsigned char* data, size_t size, size_t base_offset) noexcept {
+            if (base_offset > size || size - base_offset < 12)
                 return false;
-            io.seek(4, SEEK_CUR);
-            size_t num_tables = read_be<uint16_t>(io);
-            if (16 * num_tables + 12 > ttf_size)
+            auto header = data + base_offset;
+            size_t num_tables = get_be<uint16_t>(header + 4);
+            if (16 * num_tables + 12 > size - base_offset)
                 return false;
-            io.seek(6, SEEK_CUR);
             for (size_t i = 0; i < num_tables; ++i) {
-                io.seek(8, SEEK_CUR);
-                size_t offset = read_be<uint32_t>(io);
-                size_t length = read_be<uint32_t>(io);
-                if (offset + length > file_size)
+                auto record = header + 12 + 16 * i;
+                size_t offset = get_be<uint32_t>(record + 8);
+                size_t length = get_be<uint32_t>(record + 12);
+                if (offset + length > size)
                     return false;
             }
             return true;
         }
 
-        bool verify_ttc(Cstdio& io) noexcept {
-            size_t file_size = get_file_size(io);
-            if (file_size < 12)
+        bool verify_ttc(const unsigned char* data, size_t size) noexcept {
+            if (size < 12)
                 return false;
-            io.seek(8, SEEK_CUR);
-            size_t num_fonts = read_be<uint32_t>(io);
-            if (4 * num_fonts + 12 > file_size)
+            size_t num_fonts = get_be<uint32_t>(data + 8);
+            if (4 * num_fonts + 12 > size)
                 return false;
-            std::vector<size_t> offsets(num_fonts);
-            for (size_t& ofs: offsets) {
-                ofs = read_be<uint32_t>(io);
-                if (ofs >= file_size)
-                    return false;
-            }
-            for (size_t ofs: offsets) {
-                io.seek(ofs, SEEK_SET);
-                if (! verify_ttf(io, ofs, file_size))
+            for (size_t i = 0; i < num_fonts; ++i) {
+                size_t offset = get_be<uint32_t>(data + 12 + 4 * i);
+                if (offset >= size || ! verify_ttf(data, size, offset))
                     return false;
             }
             return true;
         }
 
-        bool verify_font_data(Cstdio& io) noexcept {
-            auto magic = read_be<uint32_t>(io);
-            io.seek(-4, SEEK_CUR);
-            switch (magic) {
+        bool verify_font_data(const unsigned char* data, size_t size) noexcept {
+            if (size < 4)
+                return false;
+            switch (get_be<uint32_t>(data)) {
                 case ttf_magic:
                 case otf_magic:
-                    return verify_ttf(io, 0, IO::npos);
+                    return verify_ttf(data, size, 0);
                 case ttc_magic:
-                    return verify_ttc(io);
+                    return verify_ttc(data, size);
                 default:
                     return false;
             }
         }
 
+        // Identifies one version of a file: if any field changes, the file
+        // has been modified or replaced. Device and inode are not available
+        // on Windows, and are left as zero.
+
+        struct FileStamp {
+            uint64_t device = 0;
+            uint64_t inode = 0;
+            uint64_t size = 0;
+            int64_t modified = 0;
+            bool operator==(const FileStamp& s) const noexcept {
+                return device == s.device && inode == s.inode && size == s.size && modified == s.modified;
+            }
+            bool operator!=(const FileStamp& s) const noexcept { return ! (*this == s); }
+        };
+
+        // Returns false unless the file is a non-empty regular file.
+
+        bool get_file_stamp(const Path& file, FileStamp& stamp) {
+            #ifdef _WIN32
+                auto path = std::filesystem::u8path(file.name());
+                std::error_code ec;
+                if (! std::filesystem::is_regular_file(path, ec))
+                    return false;
+                auto time = std::filesystem::last_write_time(path, ec);
+                if (ec)
+                    return false;
+                auto size = std::filesystem::file_size(path, ec);
+                if (ec || size == 0)
+                    return false;
+                stamp = {0, 0, uint64_t(size), int64_t(time.time_since_epoch().count())};
+            #else
+                struct stat status;
+                if (stat(file.name().data(), &status) != 0 || ! S_ISREG(status.st_mode) || status.st_size <= 0)
+                    return false;
+                stamp = {uint64_t(status.st_dev), uint64_t(status.st_ino), uint64_t(status.st_size), int64_t(status.st_mtime)};
+            #endif
+            return true;
+        }
+
+        // Read-only view of a file's contents, memory mapped where possible.
+
+        class MappedFile {
+
+        public:
+
+            MappedFile() = default;
+            ~MappedFile() noexcept { reset(); }
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            const unsigned char* data() const noexcept { return data_; }
+            size_t size() const noexcept { return size_; }
+            const FileStamp& stamp() const noexcept { return stamp_; } // Stamp of the file when it was opened
+
+            #ifdef _WIN32
+
+                bool open(const Path& file) {
+                    reset();
+                    if (! get_file_stamp(file, stamp_))
+                        return false;
+                    try {
+                        Cstdio io(file, "rb");
+                        buffer_ = io.read_all();
+                    }
+                    catch (const IoError&) {
+                        return false;
+                    }
+                    if (buffer_.empty())
+                        return false;
+                    data_ = reinterpret_cast<const unsigned char*>(buffer_.data());
+                    size_ = buffer_.size();
+                    return true;
+                }
+
+                void reset() noexcept {
+                    buffer_.clear();
+                    data_ = nullptr;
+                    size_ = 0;
+                    stamp_ = {};
+                }
+
+            #else
+
+                bool open(const Path& file) {
+                    reset();
+                    int fd = ::open(file.name().data(), O_RDONLY);
+                    if (fd == -1)
+                        return false;
+                    struct stat status;
+                    if (fstat(fd, &status) != 0 || ! S_ISREG(status.st_mode) || status.st_size <= 0) {
+                        ::close(fd);
+                        return false;
+                    }
+                    auto size = size_t(status.st_size);
+                    void* ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                    ::close(fd);
+                    if (ptr == MAP_FAILED)
+                        return false;
+                    data_ = static_cast<const unsigned char*>(ptr);
+                    size_ = size;
+                    stamp_ = {uint64_t(status.st_dev), uint64_t(status.st_ino), uint64_t(status.st_size), int64_t(status.st_mtime)};
+                    return true;
+                }
+
+                void reset() noexcept {
+                    if (data_ != nullptr)
+                        munmap(const_cast<unsigned char*>(data_), size_);
+                    data_ = nullptr;
+                    size_ = 0;
+                    stamp_ = {};
+                }
+
+            #endif
+
+        private:
+
+            const unsigned char* data_ = nullptr;
+            size_t size_ = 0;
+            FileStamp stamp_;
+
+            #ifdef _WIN32
+                std::string buffer_;
+            #endif
+
+        };
+
+        // Call f(first,last) for each range of code points listed in the
+        // font's Unicode cmap subtable. Ranges may include code points that
+        // actually map to the missing glyph. Returns false if the font has no
+        // cmap, the subtable format is not one we know how to walk, or the
+        // subtable runs past the end of the file. Nothing is reported unless
+        // the whole subtable checks out, and a subtable that passes is safe to
+        // query with stbtt_FindGlyphIndex() for any code point in the ranges.
+
+        // https://docs.microsoft.com/en-us/typography/opentype/spec/cmap
+
+        template <typename F>
+        bool for_each_cmap_range(const FontCoreInfo& font, F f) {
+
+            size_t index_map = font.info.index_map;
+
+            if (index_map == 0 || index_map >= font.data_size)
+                return false;
+
+            auto table = font.info.data + index_map;
+            size_t available = font.data_size - index_map;
+
+            if (available < 2)
+                return false;
+
+            switch (get_be<uint16_t>(table)) {
+
+                case 0: {
+                    if (available < 262)
+                        return false;
+                    for (uint32_t c = 0; c < 256; ++c)
+                        if (table[6 + c] != 0)
+                            f(c, c);
+                    return true;
+                }
+
+                case 4: {
+
+                    if (available < 14)
+                        return false;
+
+                    size_t segments = get_be<uint16_t>(table + 6) / 2;
+                    size_t search_range = get_be<uint16_t>(table + 8);
+                    size_t range_shift = get_be<uint16_t>(table + 12);
+
+                    // The binary search in stbtt_FindGlyphIndex() trusts
+                    // searchRange and rangeShift to keep it inside the
+                    // segment arrays.
+
+                    if (available < 16 + 8 * segments || search_range + range_shift > 2 * segments)
+                        return false;
+
+                    auto ends = table + 14;
+                    auto starts = ends + 2 * segments + 2;
+                    auto range_offsets = starts + 4 * segments;
+
+                    for (size_t i = 0; i < segments; ++i) {
+                        size_t first = get_be<uint16_t>(starts + 2 * i);
+                        size_t last = get_be<uint16_t>(ends + 2 * i);
+                        size_t range_offset = get_be<uint16_t>(range_offsets + 2 * i);
+                        size_t glyph_ids = range_offsets + 2 * i + range_offset - table;
+                        if (first <= last && range_offset != 0 && available < glyph_ids + 2 * (last - first) + 2)
+                            return false;
+                    }
+
+                    for (size_t i = 0; i < segments; ++i) {
+                        uint32_t first = get_be<uint16_t>(starts + 2 * i);
+                        uint32_t last = get_be<uint16_t>(ends + 2 * i);
+                        if (first <= last && first != 0xffff)
+                            f(first, last);
+                    }
+
+                    return true;
+
+                }
+
+                case 6: {
+                    if (available < 10)
+                        return false;
+                    uint32_t first = get_be<uint16_t>(table + 6);
+                    uint32_t count = get_be<uint16_t>(table + 8);
+                    if (available < 10 + 2 * size_t(count))
+                        return false;
+                    if (count != 0)
+                        f(first, first + count - 1);
+                    return true;
+                }
+
+                case 12:
+                case 13: {
+                    if (available < 16)
+                        return false;
+                    size_t groups = get_be<uint32_t>(table + 12);
+                    if (groups > (available - 16) / 12)
+                        return false;
+                    for (size_t i = 0; i < groups; ++i) {
+                        auto group = table + 16 + 12 * i;
+                        uint32_t first = get_be<uint32_t>(group);
+                        uint32_t last = std::min(get_be<uint32_t>(group + 4), uint32_t(0x10ffff));
+                        if (first <= last)
+                            f(first, last);
+                    }
+                    return true;
+                }
+
+                default:
+                    return false;
+
+            }
+
+        }
+
+        // The coverage summary has one bit per 256 code point block, covering
+        // Unicode planes 0-2. It may over-report coverage but never
+        // under-reports it; if the cmap can't be walked, every block is
+        // marked.
+
+        using CoverageSummary = std::array<uint64_t, 12>;
+
+        constexpr uint32_t summary_limit = 0x30000;
+
+        CoverageSummary summarize_coverage(const FontCoreInfo& font) {
+            CoverageSummary summary = {};
+            auto mark = [&summary] (uint32_t first, uint32_t last) {
+                last = std::min(last, summary_limit - 1);
+                for (uint32_t block = first >> 8; first <= last && block <= last >> 8; ++block)
+                    summary[block / 64] |= uint64_t(1) << (block % 64);
+            };
+            if (! for_each_cmap_range(font, mark))
+                summary.fill(~ uint64_t(0));
+            return summary;
+        }
+
+        // Exact set of code points with glyphs in a font, stored as a two
+        // level bitmap. Each 256 code point block indexes a 256 bit page;
+        // page zero is always empty and shared by all empty blocks.
+
+        class CoverageSet {
+
+        public:
+
+            bool contains(char32_t c) const noexcept {
+                if (c >= max_code)
+                    return false;
+                auto& page = pages_[index_[c >> 8]];
+                return (page[(c >> 6) & 3] >> (c & 63)) & 1;
+            }
+
+            void insert(char32_t c) {
+                if (c >= max_code)
+                    return;
+                auto& slot = index_[c >> 8];
+                if (slot == 0) {
+                    slot = uint16_t(pages_.size());
+                    pages_.emplace_back();
+                }
+                pages_[slot][(c >> 6) & 3] |= uint64_t(1) << (c & 63);
+            }
+
+        private:
+
+            using page_type = std::array<uint64_t, 4>;
+
+            static constexpr char32_t max_code = 0x110000;
+
+            std::vector<uint16_t> index_ = std::vector<uint16_t>(max_code >> 8, 0);
+            std::vector<page_type> pages_ = std::vector<page_type>(1);
+
+        };
+
+        // Call f(i) for each i in [0,n) on a set of worker threads. The first
+        // exception thrown by f() is rethrown once all workers have stopped.
+
+        template <typename F>
+        void parallel_for(size_t n, F f) {
+
+            size_t num_threads = std::min(n, size_t(std::max(std::thread::hardware_concurrency(), 1u)));
+
+            if (num_threads <= 1) {
+                for (size_t i = 0; i < n; ++i)
+                    f(i);
+                return;
+            }
+
+            std::atomic<size_t> next(0);
+            std::exception_ptr error;
+            std::mutex error_mutex;
+
+            auto work = [&] {
+                try {
+                    for (size_t i = next++; i < n; i = next++)
+                        f(i);
+                }
+                catch (...) {
+                    std::lock_guard lock(error_mutex);
+                    if (! error)
+                        error = std::current_exception();
+                    next = n;
+                }
+            };
+
+            std::vector<std::thread> threads;
+            for (size_t i = 1; i < num_threads; ++i)
+                threads.emplace_back(work);
+            work();
+            for (auto& t: threads)
+                t.join();
+
+            if (error)
+                std::rethrow_exception(error);
+
+        }
+
         #ifdef _WIN32
 
             Path get_windows_dir() {
@@ -344,28 +728,121 @@ namespace RS::Graphics::Plane {
     // Font class
 
     struct Font::font_impl:
-    FontCoreInfo {};
+    FontCoreInfo {
+        int collection_index = 0; // Index of the face within a collection file
+        std::once_flag coverage_flag;
+        bool coverage_valid = false; // False if the cmap is missing, unsupported, or truncated
+        CoverageSet coverage;
+        std::mutex sdf_mutex;
+        std::map<char32_t, SdfGlyph> sdf_cache;
+        bool has_glyph(char32_t c);
+        SdfGlyph sdf_glyph(char32_t c);
+    };
 
-    Font::Font(const Path& file, int index) {
+    // The coverage set is built on first use. Every code point in the cmap's
+    // ranges is checked individually, since ranges may include unmapped code
+    // points. If the cmap can't be walked, stbtt_FindGlyphIndex() would
+    // either not understand it or read past the end of it, so the font is
+    // treated as having no glyphs.
+
+    bool Font::font_impl::has_glyph(char32_t c) {
+        std::call_once(coverage_flag, [this] {
+            coverage_valid = for_each_cmap_range(*this, [this] (uint32_t first, uint32_t last) {
+                for (uint32_t code = first; code <= last; ++code)
+                    if (stbtt_FindGlyphIndex(&info, int(code)) > 0)
+                        coverage.insert(code);
+            });
+        });
+        return coverage_valid && coverage.contains(c);
+    }
 
-        if (index < 0)
-            return;
+    SdfGlyph Font::font_impl::sdf_glyph(char32_t c) {
+
+        std::unique_lock lock(sdf_mutex);
+        auto it = sdf_cache.find(c);
+        if (it != sdf_cache.end())
+            return it->second;
+        lock.unlock();
 
-        Cstdio io;
-        try {
-            io = Cstdio(file, "rb");
+        SdfGlyph glyph;
+        int width, height, xoff, yoff;
+        auto field_ptr = stbtt_GetCodepointSDF(&info, sdf_em_pixels / units_per_em, int(c), sdf_padding,
+            sdf_edge_value, sdf_pixel_distance, &width, &height, &xoff, &yoff);
+
+        if (field_ptr) {
+            glyph.field = Detail::ByteMask({width, height}, field_ptr, [] (unsigned char* ptr) { stbtt_FreeSDF(ptr, nullptr); });
+            glyph.offset = {xoff, yoff};
         }
-        catch (const IoError&) {
-            return;
+
+        lock.lock();
+        sdf_cache.insert({c, glyph});
+
+        return glyph;
+
+    }
+
+    // Font file contents are memory mapped where possible, and the mapping
+    // is shared between all Font objects loaded from the same file.
+
+    struct Font::font_file:
+    MappedFile {};
+
+    std::shared_ptr<const Font::font_file> Font::open_file(const Path& file) {
+
+        static std::mutex registry_mutex;
+        static std::map<std::string, std::weak_ptr<const font_file>> registry;
+        static size_t prune_size = 64;
+
+        auto name = file.name();
+        FileStamp stamp;
+        if (! get_file_stamp(file, stamp))
+            return {};
+
+        std::unique_lock lock(registry_mutex);
+        auto it = registry.find(name);
+
+        if (it != registry.end()) {
+            auto content = it->second.lock();
+            if (content && content->stamp() == stamp)
+                return content;
         }
 
-        if (! verify_font_data(io))
+        lock.unlock();
+
+        // Verification only touches the table directories, so only those
+        // pages of the file are actually read at this point
+
+        auto content = std::make_shared<font_file>();
+        if (! content->open(file) || ! verify_font_data(content->data(), content->size()))
+            return {};
+
+        lock.lock();
+        registry[name] = content;
+
+        if (registry.size() >= prune_size) {
+            for (auto i = registry.begin(); i != registry.end();) {
+                if (i->second.expired())
+                    i = registry.erase(i);
+                else
+                    ++i;
+            }
+            prune_size = std::max(size_t(64), 2 * registry.size());
+        }
+
+        return content;
+
+    }
+
+    Font::Font(const Path& file, int index) {
+
+        if (index < 0)
             return;
 
-        io.seek(0, SEEK_SET);
-        auto content = std::make_shared<std::string>();
-        *content = io.read_all();
-        auto data = reinterpret_cast<const unsigned char*>(content->data());
+        auto content = open_file(file);
+        if (! content)
+            return;
+
+        auto data = content->data();
         int num_fonts = stbtt_GetNumberOfFonts(data);
 
         if (index >= num_fonts)
@@ -374,9 +851,11 @@ namespace RS::Graphics::Plane {
         int offset = stbtt_GetFontOffsetForIndex(data, index);
         auto impl = std::make_shared<font_impl>();
 
-        if (! init_font(*impl, data, offset))
+        if (! init_font(*impl, data, content->size(), offset))
             return;
 
+        impl->collection_index = index;
+
         content_ = content;
         font_ = impl;
 
@@ -410,33 +889,20 @@ namespace RS::Graphics::Plane {
     std::vector<Font> Font::load(const Path& file) {
 
         std::vector<Font> fonts;
-
-        Cstdio io;
-        try {
-            io = Cstdio(file, "rb");
-        }
-        catch (const IoError&) {
-            return fonts;
-        }
-
-        if (! verify_font_data(io))
+        auto content = open_file(file);
+        if (! content)
             return fonts;
 
-        io.seek(0, SEEK_SET);
-        auto content = std::make_shared<std::string>();
-        *content = io.read_all();
-        if (content->empty())
-            return fonts;
-
-        auto data = reinterpret_cast<const unsigned char*>(content->data());
+        auto data = content->data();
         int num_fonts = stbtt_GetNumberOfFonts(data);
         Font font;
 
         for (int i = 0; i < num_fonts; ++i) {
             int offset = stbtt_GetFontOffsetForIndex(data, i);
             auto impl = std::make_shared<font_impl>();
-            if (! init_font(*impl, data, offset))
+            if (! init_font(*impl, data, content->size(), offset))
                 continue;
+            impl->collection_index = i;
             font.content_ = content;
             font.font_ = impl;
             fonts.push_back(font);
@@ -447,7 +913,7 @@ namespace RS::Graphics::Plane {
     }
 
     bool Font::has_glyph_unchecked(char32_t c) const noexcept {
-        return is_unicode(c) && stbtt_FindGlyphIndex(&font_->info, int(c)) > 0;
+        return is_unicode(c) && font_->has_glyph(c);
     }
 
     // ScaledFont class
@@ -458,17 +924,45 @@ namespace RS::Graphics::Plane {
         int line_gap_pixels = 0;
         Point pixels_per_em = Point::null();
         Float2 pixels_per_unit = Float2::null();
+        FontRender flags = FontRender::none;
+        struct face_type;
+        std::vector<face_type> faces; // Primary font first, then fallbacks
+        std::mutex glyph_mutex;
+        std::map<std::pair<char32_t, int>, glyph_placement> glyph_cache; // Keyed by character and subpixel phase
+    };
+
+    // Each font in a chain is scaled to the same number of pixels per em.
+    // Vertical metrics always come from the primary font, so all glyphs
+    // share its baseline.
+
+    struct ScaledFont::scaled_impl::face_type {
+        std::shared_ptr<const font_file> content;
+        std::shared_ptr<font_impl> font;
+        Float2 pixels_per_unit;
     };
 
-    ScaledFont::ScaledFont(const Font& font, Point scale) noexcept:
+    ScaledFont::ScaledFont(const Font& font, Point scale, FontRender flags) noexcept:
     Font(font),
     scaled_(std::make_shared<scaled_impl>()) {
         if (font_) {
+            scaled_->flags = flags;
             scaled_->pixels_per_em = scale;
             scaled_->pixels_per_unit = Float2(scale) / font_->units_per_em;
             scaled_->ascent_pixels = scale_y(font_->ascent);
             scaled_->descent_pixels = scale_y(font_->descent);
             scaled_->line_gap_pixels = scale_y(font_->line_gap);
+            scaled_->faces.push_back({content_, font_, scaled_->pixels_per_unit});
+        }
+    }
+
+    ScaledFont::ScaledFont(const std::vector<Font>& fonts, Point scale, FontRender flags) {
+        for (auto& font: fonts) {
+            if (! font)
+                continue;
+            if (font_)
+                scaled_->faces.push_back({font.content_, font.font_, Float2(scale) / font.font_->units_per_em});
+            else
+                *this = ScaledFont(font, scale, flags);
         }
     }
 
@@ -494,22 +988,22 @@ namespace RS::Graphics::Plane {
             return {};
 
         auto utext = decode_string(text);
-        int x = 0, y = 0;
+        float pen = 0;
+        int x = 0, y = 0, phase = 0;
         int x0 = 0, x1 = 0, y0 = 0, y1 = 0;
         int min_x = 0, min_y = 0, max_x = 0, max_y = 0;
         size_t length = utext.size();
-        float sx = scaled_->pixels_per_unit.x();
-        float sy = scaled_->pixels_per_unit.y();
 
         for (size_t i = 0; i < length; ++i) {
 
             if (utext[i] == '\n') {
-                x = 0;
+                pen = 0;
                 y += ascent() - descent() + line_gap() + line_shift;
                 continue;
             }
 
-            stbtt_GetCodepointBitmapBox(&font_->info, int(utext[i]), sx, sy, &x0, &y0, &x1, &y1);
+            split_pen(pen, x, phase);
+            glyph_box(utext[i], phase, x0, y0, x1, y1);
 
             if (x0 != 0 || y0 != 0 || x1 != 0 || y1 != 0) {
                 min_x = std::min(min_x, x + x0);
@@ -518,12 +1012,8 @@ namespace RS::Graphics::Plane {
                 max_y = std::max(max_y, y + y1);
             }
 
-            if (i + 1 < length) {
-                int advance, left_bearing;
-                stbtt_GetCodepointHMetrics(&font_->info, int(utext[i]), &advance, &left_bearing);
-                int kern_advance = stbtt_GetCodepointKernAdvance(&font_->info, int(utext[i]), int(utext[i + 1]));
-                x += scale_x(advance + kern_advance);
-            }
+            if (i + 1 < length)
+                pen += pen_advance(utext[i], utext[i + 1]);
 
         }
 
@@ -541,19 +1031,19 @@ namespace RS::Graphics::Plane {
             return 0;
 
         auto utext = decode_string(text);
+        float pen = 0;
         int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
-        int x = 0, min_x = 0, max_x = 0;
+        int x = 0, phase = 0, min_x = 0, max_x = 0;
         size_t length = utext.size();
         size_t i = 0;
-        float sx = scaled_->pixels_per_unit.x();
-        float sy = scaled_->pixels_per_unit.y();
 
         for (i = 0; i < length; ++i) {
 
             if (utext[i] == U'\n')
                 throw std::invalid_argument("Multiple lines in text fit test");
 
-            stbtt_GetCodepointBitmapBox(&font_->info, int(utext[i]), sx, sy, &x0, &y0, &x1, &y1);
+            split_pen(pen, x, phase);
+            glyph_box(utext[i], phase, x0, y0, x1, y1);
 
             if (x0 != 0 || y0 != 0 || x1 != 0 || y1 != 0) {
                 min_x = std::min(min_x, x + x0);
@@ -563,12 +1053,8 @@ namespace RS::Graphics::Plane {
                     break;
             }
 
-            if (i + 1 < length) {
-                int advance, left_bearing;
-                stbtt_GetCodepointHMetrics(&font_->info, int(utext[i]), &advance, &left_bearing);
-                int kern_advance = stbtt_GetCodepointKernAdvance(&font_->info, int(utext[i]), int(utext[i + 1]));
-                x += scale_x(advance + kern_advance);
-            }
+            if (i + 1 < length)
+                pen += pen_advance(utext[i], utext[i + 1]);
 
         }
 
@@ -624,80 +1110,227 @@ namespace RS::Graphics::Plane {
 
     }
 
-    Detail::ByteMask ScaledFont::render_glyph_mask(char32_t c, Point& offset) const {
-        using namespace Detail;
-        offset = Point::null();
-        int width, height, xoff, yoff;
-        auto bitmap_ptr = stbtt_GetCodepointBitmap(&font_->info, scaled_->pixels_per_unit.x(), scaled_->pixels_per_unit.y(),
-            int(c), &width, &height, &xoff, &yoff);
-        if (! bitmap_ptr)
-            return {};
-        ByteMask mask({width, height}, bitmap_ptr, free_stb_bitmap);
-        offset = {xoff, yoff};
-        return mask;
-    }
-
-    Detail::ByteMask ScaledFont::render_text_mask(const std::u32string& utext, int line_shift, Point& offset) const {
-
-        using namespace Detail;
+    std::vector<ScaledFont::glyph_placement> ScaledFont::layout_glyphs(const std::u32string& utext, int line_shift) const {
 
         size_t length = utext.size();
-        std::vector<ByteMask> glyph_masks(length);
-        std::vector<Point> glyph_offsets(length); // Top left of glyph relative to initial reference point
+        std::vector<glyph_placement> glyphs;
+        glyphs.reserve(length);
         int line_delta = line_offset() + line_shift;
-        int min_x = 0, max_x = 0, min_y = 0, max_y = 0;
-        Point ref_point = Point::null();
+        float pen = 0;
+        int x = 0, y = 0, phase = 0;
 
         for (size_t i = 0; i < length; ++i) {
 
             if (utext[i] == U'\n') {
 
-                ref_point.x() = 0;
-                ref_point.y() += line_delta;
+                pen = 0;
+                y += line_delta;
 
             } else {
 
-                glyph_masks[i] = render_glyph_mask(utext[i], glyph_offsets[i]);
-                glyph_offsets[i] += ref_point;
-                min_x = std::min(min_x, glyph_offsets[i].x());
-                min_y = std::min(min_y, glyph_offsets[i].y());
-                max_x = std::max(max_x, glyph_offsets[i].x() + glyph_masks[i].shape().x());
-                max_y = std::max(max_y, glyph_offsets[i].y() + glyph_masks[i].shape().y());
-                int advance, left_bearing;
-                stbtt_GetCodepointHMetrics(&font_->info, int(utext[i]), &advance, &left_bearing);
-                ref_point.x() += scale_x(advance);
-                if (i + 1 < length && utext[i + 1] != U'\n')
-                    ref_point.x() += scale_x(stbtt_GetCodepointKernAdvance(&font_->info, int(utext[i]), int(utext[i + 1])));
+                split_pen(pen, x, phase);
+                auto glyph = render_glyph_mask(utext[i], phase);
+                if (! glyph.mask.empty()) {
+                    glyph.offset += Point{x, y};
+                    glyphs.push_back(std::move(glyph));
+                }
+                pen += pen_advance(utext[i], i + 1 < length ? utext[i + 1] : U'\n');
+
+            }
+
+        }
+
+        return glyphs;
+
+    }
+
+    ScaledFont::glyph_placement ScaledFont::render_glyph_mask(char32_t c, int phase) const {
+
+        using namespace Detail;
 
+        std::pair<char32_t, int> key = {c, phase};
+        std::unique_lock lock(scaled_->glyph_mutex);
+        auto it = scaled_->glyph_cache.find(key);
+        if (it != scaled_->glyph_cache.end())
+            return it->second;
+        lock.unlock();
+
+        glyph_placement glyph;
+        glyph.offset = Point::null();
+        int x0, y0, x1, y1;
+        glyph_box(c, phase, x0, y0, x1, y1);
+        Point shape = {x1 - x0, y1 - y0};
+
+        if (shape.x() > 0 && shape.y() > 0) {
+            auto& face = scaled_->faces[face_index(c)];
+            glyph.mask = ByteMask(shape);
+            glyph.offset = {x0, y0};
+            if (!! (scaled_->flags & FontRender::sdf)) {
+                auto sdf = face.font->sdf_glyph(c);
+                if (! sdf.field.empty())
+                    render_from_sdf(sdf, face.pixels_per_unit * (face.font->units_per_em / sdf_em_pixels),
+                        subpixel_shift(phase), glyph.offset, glyph.mask);
+            } else {
+                stbtt_MakeCodepointBitmapSubpixel(&face.font->info, glyph.mask.begin(), shape.x(), shape.y(), shape.x(),
+                    face.pixels_per_unit.x(), face.pixels_per_unit.y(), subpixel_shift(phase), 0, int(c));
             }
+        }
+
+        lock.lock();
+        scaled_->glyph_cache.insert({key, glyph});
+
+        return glyph;
+
+    }
+
+    Detail::SparseByteMask ScaledFont::render_text_mask(const std::u32string& utext, int line_shift, Point& offset) const {
+        return merge_glyphs(layout_glyphs(utext, line_shift), offset);
+    }
+
+    // Glyphs are merged a row at a time into a single reusable buffer, and
+    // only the non-zero runs are kept, so no dense mask the size of the whole
+    // text is ever allocated.
+
+    Detail::SparseByteMask ScaledFont::merge_glyphs(const std::vector<glyph_placement>& glyphs, Point& offset) {
+
+        using namespace Detail;
 
+        int min_x = 0, max_x = 0, min_y = 0, max_y = 0;
+
+        for (auto& glyph: glyphs) {
+            min_x = std::min(min_x, glyph.offset.x());
+            min_y = std::min(min_y, glyph.offset.y());
+            max_x = std::max(max_x, glyph.offset.x() + glyph.mask.shape().x());
+            max_y = std::max(max_y, glyph.offset.y() + glyph.mask.shape().y());
         }
 
         offset = {min_x, min_y};
         Point text_shape = Point{max_x, max_y} - offset;
-        ByteMask text_mask(text_shape);
+        SparseByteMask text_mask(text_shape);
 
-        for (size_t i = 0; i < length; ++i) {
+        if (text_shape.x() <= 0 || text_shape.y() <= 0)
+            return text_mask;
 
-            if (glyph_masks[i].empty())
-                continue;
+        std::vector<const glyph_placement*> pending;
+
+        for (auto& glyph: glyphs)
+            if (! glyph.mask.empty())
+                pending.push_back(&glyph);
+
+        std::stable_sort(pending.begin(), pending.end(),
+            [] (const glyph_placement* a, const glyph_placement* b) { return a->offset.y() < b->offset.y(); });
+
+        std::vector<const glyph_placement*> active;
+        std::vector<unsigned char> row(size_t(text_shape.x()), 0);
+        size_t next = 0;
 
-            auto glyph_offset = glyph_offsets[i] - offset;
-            Point shape = glyph_masks[i].shape();
+        for (int text_y = 0; text_y < text_shape.y(); ++text_y) {
 
-            for (int glyph_y = 0, text_y = glyph_offset.y(); glyph_y < shape.y(); ++glyph_y, ++text_y) {
-                auto glyph_ptr = &glyph_masks[i][{0, glyph_y}];
-                auto text_ptr = &text_mask[{glyph_offset.x(), text_y}];
-                for (int x = 0; x < shape.x(); ++x, ++text_ptr, ++glyph_ptr)
-                    *text_ptr = std::max(*text_ptr, *glyph_ptr);
+            int y = text_y + offset.y();
+
+            while (next < pending.size() && pending[next]->offset.y() <= y)
+                active.push_back(pending[next++]);
+
+            active.erase(std::remove_if(active.begin(), active.end(),
+                [y] (const glyph_placement* g) { return g->offset.y() + g->mask.shape().y() <= y; }),
+                active.end());
+
+            if (active.empty())
+                continue;
+
+            int x1 = text_shape.x(), x2 = 0;
+
+            for (auto glyph: active) {
+                int glyph_x = glyph->offset.x() - offset.x();
+                int width = glyph->mask.shape().x();
+                auto glyph_ptr = &glyph->mask[{0, y - glyph->offset.y()}];
+                auto row_ptr = row.data() + glyph_x;
+                for (int x = 0; x < width; ++x)
+                    row_ptr[x] = std::max(row_ptr[x], glyph_ptr[x]);
+                x1 = std::min(x1, glyph_x);
+                x2 = std::max(x2, glyph_x + width);
             }
 
+            text_mask.append_row(text_y, x1, row.data() + x1, x2 - x1);
+            std::fill(row.begin() + x1, row.begin() + x2, 0);
+
         }
 
         return text_mask;
 
     }
 
+    std::vector<ScaledFont::text_placement> ScaledFont::layout_batch(const std::vector<batch_label>& labels) {
+        std::vector<text_placement> layouts(labels.size());
+        parallel_for(labels.size(), [&labels, &layouts] (size_t i) {
+            auto& label = labels[i];
+            if (! label.text->empty())
+                layouts[i].mask = label.font->render_text_mask(decode_string(*label.text), label.line_shift, layouts[i].offset);
+        });
+        return layouts;
+    }
+
+    void ScaledFont::for_each_band(int height, const std::function<void(int, int)>& f) {
+        static constexpr int min_band_height = 16;
+        size_t max_bands = size_t(std::max(height / min_band_height, 1));
+        size_t num_bands = std::min(max_bands, size_t(std::max(std::thread::hardware_concurrency(), 1u)));
+        parallel_for(num_bands, [height, num_bands, &f] (size_t i) {
+            int y1 = int(i * size_t(height) / num_bands);
+            int y2 = int((i + 1) * size_t(height) / num_bands);
+            f(y1, y2);
+        });
+    }
+
+    // The glyph for each character comes from the first font in the chain
+    // that has one, or from the primary font if none of them do. The
+    // coverage bitmaps make this a constant time check per font, so the
+    // choice doesn't need to be cached separately.
+
+    size_t ScaledFont::face_index(char32_t c) const noexcept {
+        auto& faces = scaled_->faces;
+        if (faces.size() > 1 && is_unicode(c) && ! font_->has_glyph(c))
+            for (size_t i = 1; i < faces.size(); ++i)
+                if (faces[i].font->has_glyph(c))
+                    return i;
+        return 0;
+    }
+
+    void ScaledFont::glyph_box(char32_t c, int phase, int& x0, int& y0, int& x1, int& y1) const noexcept {
+        auto& face = scaled_->faces[face_index(c)];
+        stbtt_GetCodepointBitmapBoxSubpixel(&face.font->info, int(c), face.pixels_per_unit.x(), face.pixels_per_unit.y(),
+            subpixel_shift(phase), 0, &x0, &y0, &x1, &y1);
+    }
+
+    float ScaledFont::pen_advance(char32_t c, char32_t next) const noexcept {
+        size_t index = face_index(c);
+        auto& face = scaled_->faces[index];
+        int advance, left_bearing;
+        stbtt_GetCodepointHMetrics(&face.font->info, int(c), &advance, &left_bearing);
+        int kern_advance = 0;
+        if (next != U'\n' && face_index(next) == index)
+            kern_advance = stbtt_GetCodepointKernAdvance(&face.font->info, int(c), int(next));
+        float unit = face.pixels_per_unit.x();
+        if (!! (scaled_->flags & FontRender::subpixel))
+            return unit * float(advance + kern_advance);
+        else
+            return std::round(unit * float(advance)) + std::round(unit * float(kern_advance));
+    }
+
+    void ScaledFont::split_pen(float pen, int& x, int& phase) const noexcept {
+        if (!! (scaled_->flags & FontRender::subpixel)) {
+            float whole = std::floor(pen);
+            x = int(whole);
+            phase = int(std::lround((pen - whole) * float(subpixel_phases)));
+            if (phase == subpixel_phases) {
+                ++x;
+                phase = 0;
+            }
+        } else {
+            x = int(std::lround(pen));
+            phase = 0;
+        }
+    }
+
     int ScaledFont::scale_x(int x) const noexcept {
         return int(std::lround(scaled_->pixels_per_unit.x() * float(x)));
     }
@@ -716,6 +1349,333 @@ namespace RS::Graphics::Plane {
 
     // FontMap class
 
+    namespace {
+
+        // Process-wide cache of fonts loaded through a FontMap, keyed by file
+        // and face index, with least recently used eviction. The size budget
+        // counts each font file once, however many faces are cached from it.
+        // Hits never touch the file system; a search that finds a file has
+        // changed since its fonts were cached drops all of its entries.
+
+        constexpr size_t default_font_cache_limit = 256ul << 20;
+
+        struct FontCache {
+
+            using key_type = std::pair<std::string, int>;
+
+            struct entry_type {
+                Font font;
+                std::list<key_type>::iterator lru;
+            };
+
+            struct file_type {
+                size_t faces = 0;
+                size_t bytes = 0;
+            };
+
+            std::mutex mutex;
+            size_t limit = default_font_cache_limit;
+            size_t bytes = 0;
+            std::map<key_type, entry_type> fonts;
+            std::map<std::string, file_type> files;
+            std::list<key_type> lru; // Most recently used first
+
+            void erase(std::map<key_type, entry_type>::iterator it) {
+                auto file = files.find(it->first.first);
+                lru.erase(it->second.lru);
+                fonts.erase(it);
+                if (--file->second.faces == 0) {
+                    bytes -= file->second.bytes;
+                    files.erase(file);
+                }
+            }
+
+            void erase_file(const std::string& name) {
+                auto it = fonts.lower_bound({name, std::numeric_limits<int>::min()});
+                while (it != fonts.end() && it->first.first == name)
+                    erase(it++);
+            }
+
+            void evict_one() {
+                erase(fonts.find(lru.back()));
+            }
+
+            void trim(size_t keep) {
+                while (lru.size() > keep && bytes > limit)
+                    evict_one();
+            }
+
+        };
+
+        FontCache& font_cache() {
+            static FontCache cache;
+            return cache;
+        }
+
+    }
+
+    // The font index is a cache file recording the fonts found in each file
+    // scanned by search_system(), so that unchanged files don't need to be
+    // opened and parsed again. Files are matched by modification time and
+    // size. The index is written in native byte order; an index from a
+    // different version or platform is simply ignored and rebuilt.
+
+    struct FontMap::font_index {
+
+        struct face_record {
+            int index;
+            std::string family;
+            std::string subfamily;
+            coverage_summary coverage;
+        };
+
+        struct file_record {
+            int64_t modified = 0;
+            uint64_t size = 0;
+            std::vector<face_record> faces; // Empty if the file holds no usable fonts
+        };
+
+        static constexpr const char* magic = "RSFONTIX";
+        static constexpr size_t magic_size = 8;
+        static constexpr uint32_t version = 2;
+
+        std::map<std::string, file_record> previous; // Read from the index file
+        std::map<std::string, file_record> current; // Files seen in this search
+        bool changed = false;
+
+        void load(const Path& index_file);
+        void save(const Path& index_file) const;
+        static bool get_stamp(const Path& file, int64_t& modified, uint64_t& size);
+
+    };
+
+    namespace {
+
+        class IndexReader {
+        public:
+            IndexReader(const unsigned char* data, size_t size) noexcept: ptr_(data), end_(data + size) {}
+            bool ok() const noexcept { return ok_; }
+            bool done() const noexcept { return ptr_ == end_; }
+            template <typename T> T get() noexcept {
+                T t = 0;
+                if (! check(sizeof(T)))
+                    return t;
+                std::memcpy(&t, ptr_, sizeof(T));
+                ptr_ += sizeof(T);
+                return t;
+            }
+            std::string get_string() {
+                auto len = get<uint32_t>();
+                if (! check(len))
+                    return {};
+                std::string str(reinterpret_cast<const char*>(ptr_), len);
+                ptr_ += len;
+                return str;
+            }
+        private:
+            const unsigned char* ptr_;
+            const unsigned char* end_;
+            bool ok_ = true;
+            bool check(size_t n) noexcept {
+                if (ok_ && size_t(end_ - ptr_) < n)
+                    ok_ = false;
+                return ok_;
+            }
+        };
+
+        class IndexWriter {
+        public:
+            const std::string& str() const noexcept { return buf_; }
+            template <typename T> void put(T t) {
+                buf_.append(reinterpret_cast<const char*>(&t), sizeof(T));
+            }
+            void put_string(const std::string& str) {
+                put(uint32_t(str.size()));
+                buf_ += str;
+            }
+        private:
+            std::string buf_;
+        };
+
+    }
+
+    void FontMap::font_index::load(const Path& index_file) {
+
+        previous.clear();
+        MappedFile map;
+        if (! map.open(index_file) || map.size() < magic_size
+                || std::memcmp(map.data(), magic, magic_size) != 0)
+            return;
+
+        IndexReader in(map.data() + magic_size, map.size() - magic_size);
+        if (in.get<uint32_t>() != version)
+            return;
+
+        size_t num_files = in.get<uint32_t>();
+        std::map<std::string, file_record> files;
+
+        for (size_t i = 0; i < num_files && in.ok(); ++i) {
+            auto name = in.get_string();
+            file_record record;
+            record.modified = in.get<int64_t>();
+            record.size = in.get<uint64_t>();
+            size_t num_faces = in.get<uint32_t>();
+            for (size_t j = 0; j < num_faces && in.ok(); ++j) {
+                face_record face;
+                face.index = in.get<int32_t>();
+                face.family = in.get_string();
+                face.subfamily = in.get_string();
+                for (auto& bits: face.coverage)
+                    bits = in.get<uint64_t>();
+                record.faces.push_back(std::move(face));
+            }
+            files[name] = std::move(record);
+        }
+
+        if (in.ok() && in.done())
+            previous = std::move(files);
+
+    }
+
+    void FontMap::font_index::save(const Path& index_file) const {
+
+        IndexWriter out;
+        out.put(uint32_t(version));
+        out.put(uint32_t(current.size()));
+
+        for (auto& [name, record]: current) {
+            out.put_string(name);
+            out.put(record.modified);
+            out.put(record.size);
+            out.put(uint32_t(record.faces.size()));
+            for (auto& face: record.faces) {
+                out.put(int32_t(face.index));
+                out.put_string(face.family);
+                out.put_string(face.subfamily);
+                for (auto bits: face.coverage)
+                    out.put(bits);
+            }
+        }
+
+        // Write to a temporary file and rename it, so a concurrent reader
+        // never sees a partial index
+
+        auto path = std::filesystem::u8path(index_file.name());
+        auto temp_path = path;
+        temp_path += ".tmp";
+        std::error_code ec;
+
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            file.write(magic, magic_size);
+            file.write(out.str().data(), std::streamsize(out.str().size()));
+            if (! file)
+                ec = std::make_error_code(std::errc::io_error);
+        }
+
+        if (! ec)
+            std::filesystem::rename(temp_path, path, ec);
+        if (ec)
+            std::filesystem::remove(temp_path, ec);
+
+    }
+
+    bool FontMap::font_index::get_stamp(const Path& file, int64_t& modified, uint64_t& size) {
+        auto path = std::filesystem::u8path(file.name());
+        std::error_code ec;
+        auto time = std::filesystem::last_write_time(path, ec);
+        if (ec)
+            return false;
+        size = std::filesystem::file_size(path, ec);
+        if (ec)
+            return false;
+        modified = int64_t(time.time_since_epoch().count());
+        return true;
+    }
+
+    void FontMap::clear_cache() noexcept {
+        auto& cache = font_cache();
+        std::unique_lock lock(cache.mutex);
+        cache.fonts.clear();
+        cache.files.clear();
+        cache.lru.clear();
+        cache.bytes = 0;
+    }
+
+    void FontMap::set_cache_limit(size_t bytes) noexcept {
+        auto& cache = font_cache();
+        std::unique_lock lock(cache.mutex);
+        cache.limit = bytes;
+        cache.trim(0);
+    }
+
+    Font FontMap::cached_font(const Path& file, int index) {
+
+        auto& cache = font_cache();
+        FontCache::key_type key = {file.name(), index};
+        std::unique_lock lock(cache.mutex);
+        auto it = cache.fonts.find(key);
+
+        if (it != cache.fonts.end()) {
+            cache.lru.splice(cache.lru.begin(), cache.lru, it->second.lru);
+            return it->second.font;
+        }
+
+        lock.unlock();
+        Font font(file, index);
+        if (! font)
+            return font;
+        lock.lock();
+
+        // While the lock was released, another thread may have cached this
+        // face, or a face from a different version of the file. All cached
+        // faces of one file must share the same content.
+
+        auto first = cache.fonts.lower_bound({key.first, std::numeric_limits<int>::min()});
+        if (first != cache.fonts.end() && first->first.first == key.first) {
+            if (first->second.font.content_ != font.content_)
+                cache.erase_file(key.first);
+            else if ((it = cache.fonts.find(key)) != cache.fonts.end())
+                return it->second.font;
+        }
+
+        cache.lru.push_front(key);
+        cache.fonts[key] = {font, cache.lru.begin()};
+        auto& file_info = cache.files[key.first];
+        if (file_info.faces++ == 0) {
+            file_info.bytes = font.content_->size();
+            cache.bytes += file_info.bytes;
+        }
+        cache.trim(1);
+
+        return font;
+
+    }
+
+    // Called for each file a search visits. The file is only checked if
+    // faces from it are cached; if it has changed or gone, they are dropped.
+
+    void FontMap::revalidate_cached(const Path& file) {
+
+        auto& cache = font_cache();
+        auto name = file.name();
+        std::unique_lock lock(cache.mutex);
+
+        if (cache.files.count(name) == 0)
+            return;
+
+        lock.unlock();
+        FileStamp stamp;
+        bool stamped = get_file_stamp(file, stamp);
+        lock.lock();
+
+        auto it = cache.fonts.lower_bound({name, std::numeric_limits<int>::min()});
+        if (it != cache.fonts.end() && it->first.first == name
+                && ! (stamped && it->second.font.content_->stamp() == stamp))
+            cache.erase_file(name);
+
+    }
+
     bool FontMap::contains(const std::string& family, const std::string& subfamily) const noexcept {
         auto it = table_.find(family);
         return it != table_.end() && it->second.count(subfamily) != 0;
@@ -728,6 +1688,47 @@ namespace RS::Graphics::Plane {
         return vec;
     }
 
+    std::vector<std::string> FontMap::families_covering(const std::string& text) const {
+
+        std::u32string utext;
+        for (auto c: decode_string(text))
+            if (c >= 0x20 && (c < 0x7f || c >= 0xa0))
+                utext += c;
+
+        // Check the coverage summaries first, and only load the fonts that
+        // pass to do an exact check. Code points beyond the summary's range
+        // are left to the exact check.
+
+        coverage_summary needed = {};
+        for (auto c: utext)
+            if (c < summary_limit)
+                needed[c >> 14] |= uint64_t(1) << ((c >> 8) & 63);
+
+        auto passes_summary = [&needed] (const coverage_summary& coverage) {
+            for (size_t i = 0; i < needed.size(); ++i)
+                if ((coverage[i] & needed[i]) != needed[i])
+                    return false;
+            return true;
+        };
+
+        std::vector<std::string> vec;
+
+        for (auto& [family, inner]: table_) {
+            for (auto& [subfamily, entry]: inner) {
+                if (passes_summary(entry.coverage)) {
+                    auto font = cached_font(entry.file, entry.index);
+                    if (font && (utext.empty() || font.has_glyphs(utext))) {
+                        vec.push_back(family);
+                        break;
+                    }
+                }
+            }
+        }
+
+        return vec;
+
+    }
+
     std::vector<std::string> FontMap::subfamilies(const std::string& family) const {
         std::vector<std::string> vec;
         auto it = table_.find(family);
@@ -769,7 +1770,7 @@ namespace RS::Graphics::Plane {
                 auto sub_it = subfamilies.find(name);
                 if (sub_it != subfamilies.end()) {
                     auto& result = sub_it->second;
-                    return Font(result.file, result.index);
+                    return cached_font(result.file, result.index);
                 }
             }
         }
@@ -780,7 +1781,7 @@ namespace RS::Graphics::Plane {
                 if (fam_it != table_.end()) {
                     auto& subfamilies = fam_it->second;
                     auto& result = subfamilies.begin()->second;
-                    return Font(result.file, result.index);
+                    return cached_font(result.file, result.index);
                 }
             }
         }
@@ -789,6 +1790,39 @@ namespace RS::Graphics::Plane {
 
     }
 
+    std::vector<Font> FontMap::find_chain(const std::vector<std::string>& families, const std::string& text,
+            FontStyle style) const {
+
+        std::vector<Font> fonts;
+
+        for (auto& family: families) {
+            auto font = find({family}, style);
+            if (font)
+                fonts.push_back(font);
+        }
+
+        auto covered = [&fonts] (char32_t c) {
+            return std::any_of(fonts.begin(), fonts.end(), [c] (const Font& f) { return f.has_glyph(c); });
+        };
+
+        // Add fonts from any other family that covers the missing characters,
+        // one character at a time, in order of first appearance
+
+        for (auto c: decode_string(text)) {
+            if (c < 0x20 || (c >= 0x7f && c < 0xa0) || covered(c))
+                continue;
+            auto candidates = families_covering(to_utf8(std::u32string(1, c)));
+            if (candidates.empty())
+                continue;
+            auto font = find({candidates.front()}, style | FontStyle::fallback);
+            if (font)
+                fonts.push_back(font);
+        }
+
+        return fonts;
+
+    }
+
     Font FontMap::load(const std::string& family, const std::string& subfamily) const {
         auto i = table_.find(family);
         if (i == table_.end())
@@ -797,31 +1831,99 @@ namespace RS::Graphics::Plane {
         if (j == i->second.end())
             return {};
         else
-            return Font(j->second.file, j->second.index);
+            return cached_font(j->second.file, j->second.index);
     }
 
-    void FontMap::search(const Path& dir, Path::flag flags) {
-        auto check_file = [this] (const Path& file) {
-            if (file.is_file()) {
-                int index = 0;
-                for (auto& font: Font::load(file))
-                    table_[font.family()][font.subfamily()] = {file, index++};
-            }
-        };
+    void FontMap::search_dir(const Path& dir, Path::flag flags, font_index* index) {
+        std::vector<Path> files;
         if (!! (flags & Path::flag::recurse)) {
             for (auto& file: dir.deep_search())
-                check_file(file);
+                files.push_back(file);
         } else {
             for (auto& file: dir.directory())
-                check_file(file);
+                files.push_back(file);
         }
+        add_files(files, index);
     }
 
-    void FontMap::search_system() {
+    void FontMap::add_files(const std::vector<Path>& files, font_index* index) {
+
+        struct file_result {
+            bool found = false; // File exists
+            bool stamped = false; // Modification time and size are known
+            bool indexed = false; // Record was taken unchanged from the index
+            font_index::file_record record;
+        };
+
+        std::vector<file_result> results(files.size());
+
+        // Files are parsed in parallel. Font files are memory mapped, so only
+        // the parts actually read (the table directory, name table, and cmap)
+        // are paged in.
+
+        parallel_for(files.size(), [&files, &results, index] (size_t i) {
+
+            auto& file = files[i];
+            auto& result = results[i];
+
+            revalidate_cached(file);
+
+            if (! file.is_file())
+                return;
+
+            result.found = true;
+            result.stamped = index && font_index::get_stamp(file, result.record.modified, result.record.size);
+
+            if (result.stamped) {
+                auto it = index->previous.find(file.name());
+                if (it != index->previous.end() && it->second.modified == result.record.modified
+                        && it->second.size == result.record.size) {
+                    result.record = it->second;
+                    result.indexed = true;
+                    return;
+                }
+            }
+
+            for (auto& font: Font::load(file))
+                result.record.faces.push_back({font.font_->collection_index, font.family(), font.subfamily(),
+                    summarize_coverage(*font.font_)});
+
+        });
+
+        // Merge in file order, so the result is the same as a sequential scan
+
+        for (size_t i = 0; i < files.size(); ++i) {
+            auto& result = results[i];
+            if (! result.found)
+                continue;
+            for (auto& face: result.record.faces)
+                table_[face.family][face.subfamily] = {files[i], face.index, face.coverage};
+            if (result.stamped) {
+                if (! result.indexed)
+                    index->changed = true;
+                index->current[files[i].name()] = std::move(result.record);
+            }
+        }
+
+    }
+
+    void FontMap::search(const Path& dir, Path::flag flags) {
+        search_dir(dir, flags, nullptr);
+    }
+
+    void FontMap::search_system(const Path& index_file) {
+
+        font_index index;
+        font_index* index_ptr = nullptr;
+
+        if (! index_file.empty()) {
+            index.load(index_file);
+            index_ptr = &index;
+        }
 
         #ifdef _WIN32
 
-            search(merge_paths(get_windows_dir(), "Fonts"), Path::flag::recurse);
+            search_dir(merge_paths(get_windows_dir(), "Fonts"), Path::flag::recurse, index_ptr);
 
         #else
 
@@ -847,11 +1949,14 @@ namespace RS::Graphics::Plane {
                     dir = home / (cdir + 2);
                 else
                     dir = cdir;
-                search(dir, Path::flag::recurse);
+                search_dir(dir, Path::flag::recurse, index_ptr);
             }
 
         #endif
 
+        if (index_ptr && (index.changed || index.current.size() != index.previous.size()))
+            index.save(index_file);
+
     }
 
 }
@@ -9,6 +9,9 @@
 #include "rs-format/string.hpp"
 #include "rs-io/path.hpp"
 #include "rs-tl/enum.hpp"
+#include <array>
+#include <cstdint>
+#include <functional>
 #include <map>
 #include <memory>
 #include <stdexcept>
@@ -38,6 +41,14 @@ namespace RS::Graphics::Plane {
 
     RS_DEFINE_BITMASK_OPERATORS(FontStyle)
 
+    enum class FontRender: int {
+        none      = 0,
+        subpixel  = 1,
+        sdf       = 2,
+    };
+
+    RS_DEFINE_BITMASK_OPERATORS(FontRender)
+
     class Font {
 
     public:
@@ -59,15 +70,21 @@ namespace RS::Graphics::Plane {
 
     protected:
 
+        struct font_file;
         struct font_impl;
 
-        std::shared_ptr<std::string> content_;
+        std::shared_ptr<const font_file> content_;
         std::shared_ptr<font_impl> font_;
 
     private:
 
+        friend class FontMap;
+        friend class ScaledFont;
+
         bool has_glyph_unchecked(char32_t c) const noexcept;
 
+        static std::shared_ptr<const font_file> open_file(const IO::Path& file);
+
     };
 
         template <typename Range>
@@ -80,14 +97,20 @@ namespace RS::Graphics::Plane {
             return true;
         }
 
+    template <typename C> struct TextLabel;
+
     class ScaledFont:
     public Font {
 
     public:
 
         ScaledFont() = default;
-        ScaledFont(const Font& font, int scale) noexcept: ScaledFont(font, {scale, scale}) {}
-        ScaledFont(const Font& font, Point scale) noexcept;
+        ScaledFont(const Font& font, int scale, FontRender flags = FontRender::none) noexcept:
+            ScaledFont(font, {scale, scale}, flags) {}
+        ScaledFont(const Font& font, Point scale, FontRender flags = FontRender::none) noexcept;
+        ScaledFont(const std::vector<Font>& fonts, int scale, FontRender flags = FontRender::none):
+            ScaledFont(fonts, {scale, scale}, flags) {}
+        ScaledFont(const std::vector<Font>& fonts, Point scale, FontRender flags = FontRender::none);
 
         Point scale() const noexcept;
         int ascent() const noexcept;
@@ -104,18 +127,47 @@ namespace RS::Graphics::Plane {
 
     private:
 
+        template <typename C, ImageFlags F> friend void render_batch(Image<C, F>& image, const std::vector<TextLabel<C>>& labels);
+
         static constexpr float byte_scale = 1.0f / 255.0f;
+        static constexpr int subpixel_phases = 4;
 
         struct scaled_impl;
 
+        struct glyph_placement {
+            Detail::ByteMask mask;
+            Point offset; // Top left of glyph relative to initial reference point
+        };
+
+        struct text_placement {
+            Detail::SparseByteMask mask;
+            Point offset; // Top left of text relative to initial reference point
+        };
+
+        struct batch_label {
+            const ScaledFont* font;
+            const std::string* text;
+            int line_shift;
+        };
+
         std::shared_ptr<scaled_impl> scaled_;
 
-        Detail::ByteMask render_glyph_mask(char32_t c, Point& offset) const;
-        Detail::ByteMask render_text_mask(const std::u32string& utext, int line_shift, Point& offset) const;
+        size_t face_index(char32_t c) const noexcept;
+        std::vector<glyph_placement> layout_glyphs(const std::u32string& utext, int line_shift) const;
+        glyph_placement render_glyph_mask(char32_t c, int phase) const;
+        Detail::SparseByteMask render_text_mask(const std::u32string& utext, int line_shift, Point& offset) const;
+        static Detail::SparseByteMask merge_glyphs(const std::vector<glyph_placement>& glyphs, Point& offset);
+        void glyph_box(char32_t c, int phase, int& x0, int& y0, int& x1, int& y1) const noexcept;
+        float pen_advance(char32_t c, char32_t next) const noexcept;
+        void split_pen(float pen, int& x, int& phase) const noexcept;
+        static float subpixel_shift(int phase) noexcept { return float(phase) / float(subpixel_phases); }
         int scale_x(int x) const noexcept;
         int scale_y(int y) const noexcept;
         Core::Box_i2 scale_box(Core::Box_i2 box) const noexcept;
 
+        static std::vector<text_placement> layout_batch(const std::vector<batch_label>& labels);
+        static void for_each_band(int height, const std::function<void(int, int)>& f);
+
     };
 
         template <typename C, ImageFlags F>
@@ -152,16 +204,56 @@ namespace RS::Graphics::Plane {
             if (text.empty())
                 return;
 
+            // Overlapping glyphs are merged with maximum coverage before
+            // blending, so shared pixels are not blended twice
+
             auto utext = Format::decode_string(text);
             Point offset;
             auto mask = render_text_mask(utext, line_shift, offset);
-            if (mask.empty())
-                return;
 
-            mask.onto_image(image, ref_point + offset, text_colour);
+            if (! mask.empty())
+                mask.onto_image(image, ref_point + offset, text_colour);
 
         }
 
+    template <typename C>
+    struct TextLabel {
+        ScaledFont font;
+        Point ref_point = Point::null();
+        std::string text;
+        C colour = C::black();
+        int line_shift = 0;
+    };
+
+    template <typename C, ImageFlags F>
+    void render_batch(Image<C, F>& image, const std::vector<TextLabel<C>>& labels) {
+
+        static_assert(C::is_linear);
+        static_assert(C::has_alpha);
+
+        std::vector<ScaledFont::batch_label> items;
+        items.reserve(labels.size());
+
+        for (auto& label: labels) {
+            if (! label.font)
+                throw std::invalid_argument("No font");
+            items.push_back({&label.font, &label.text, label.line_shift});
+        }
+
+        auto layouts = ScaledFont::layout_batch(items);
+
+        // Each band of rows is composited by one thread, drawing every label
+        // in order, so the result is the same as sequential rendering
+
+        ScaledFont::for_each_band(image.height(), [&] (int y1, int y2) {
+            Core::Box_i2 clip({0, y1}, {image.width(), y2 - y1});
+            for (size_t i = 0; i < labels.size(); ++i)
+                if (! layouts[i].mask.empty())
+                    layouts[i].mask.onto_image(image, labels[i].ref_point + layouts[i].offset, labels[i].colour, clip);
+        });
+
+    }
+
     class FontMap {
 
     public:
@@ -171,18 +263,29 @@ namespace RS::Graphics::Plane {
         bool contains(const std::string& family, const std::string& subfamily) const noexcept;
         bool empty() const noexcept { return table_.empty(); }
         std::vector<std::string> families() const;
+        std::vector<std::string> families_covering(const std::string& text) const;
         std::vector<std::string> subfamilies(const std::string& family) const;
         Font find(const std::vector<std::string>& families, FontStyle style = FontStyle::regular) const;
+        std::vector<Font> find_chain(const std::vector<std::string>& families, const std::string& text,
+            FontStyle style = FontStyle::regular) const;
         Font load(const std::string& family, const std::string& subfamily) const;
         void search(const IO::Path& dir, IO::Path::flag flags = IO::Path::flag::none);
-        void search_system();
+        void search_system(const IO::Path& index_file = {});
         size_t size() const noexcept { return table_.size(); }
 
+        static void clear_cache() noexcept;
+        static void set_cache_limit(size_t bytes) noexcept;
+
     private:
 
+        using coverage_summary = std::array<uint64_t, 12>; // One bit per 256 code point block in planes 0-2
+
+        struct font_index;
+
         struct mapped_type {
             IO::Path file;
             int index;
+            coverage_summary coverage;
         };
 
         using inner_table = std::map<std::string, mapped_type, Format::AsciiIcaseLess>;
@@ -190,6 +293,12 @@ namespace RS::Graphics::Plane {
 
         outer_table table_;
 
+        void search_dir(const IO::Path& dir, IO::Path::flag flags, font_index* index);
+        void add_files(const std::vector<IO::Path>& files, font_index* index);
+
+        static Font cached_font(const IO::Path& file, int index);
+        static void revalidate_cached(const IO::Path& file);
+
     };
 
 }
@@ -4,11 +4,14 @@
 
 #include "rs-graphics-2d/image.hpp"
 #include "rs-graphics-core/colour.hpp"
+#include "rs-graphics-core/geometry.hpp"
 #include <algorithm>
+#include <array>
 #include <cstring>
 #include <limits>
 #include <memory>
 #include <type_traits>
+#include <vector>
 
 namespace RS::Graphics::Plane::Detail {
 
@@ -40,6 +43,7 @@ namespace RS::Graphics::Plane::Detail {
 
         template <typename C, ImageFlags F> void make_image(Image<C, F>& image, C foreground, C background) const;
         template <typename C, ImageFlags F> void onto_image(Image<C, F>& image, Point offset, C colour) const;
+        template <typename C, ImageFlags F> void onto_image(Image<C, F>& image, Point offset, C colour, const Core::Box_i2& clip) const;
 
     private:
 
@@ -49,6 +53,10 @@ namespace RS::Graphics::Plane::Detail {
         size_t point_to_index(Point p) const noexcept { return size_t(shape_.x()) * size_t(p.y()) + size_t(p.x()); }
 
         template <typename C> static constexpr C blend(C fg, C bg, T alpha, Core::Pma pma) noexcept;
+        template <typename C, bool Premultiplied> static void fill_row(const T* in, C* out, size_t width, C foreground, C background) noexcept;
+        template <typename C, bool Premultiplied> static void blend_row(const T* in, C* out, size_t width, C colour) noexcept;
+
+        template <typename U> friend class SparseMask;
 
     };
 
@@ -72,17 +80,114 @@ namespace RS::Graphics::Plane::Detail {
 
             static constexpr Core::Pma pma = Image<C, F>::is_premultiplied ? Core::Pma::result : Core::Pma::none;
 
+            // Mask rows are written to image rows in memory order, the same
+            // coordinates onto_image() uses, whatever the image's orientation
+
             image.reset(shape());
-            auto out = image.begin();
+            auto width = size_t(shape().x());
+
+            // With constant foreground and background colours, an 8-bit mask
+            // value maps to one of only 256 possible pixels
+
+            if constexpr (std::is_same_v<T, unsigned char>) {
+
+                std::array<C, 256> table;
+                for (int i = 0; i < 256; ++i)
+                    table[i] = blend(foreground, background, T(i), pma);
+
+                for (int y = 0; y < shape().y(); ++y) {
+                    auto in = &(*this)[{0, y}];
+                    auto out = &image[{0, y}];
+                    for (size_t x = 0; x < width; ++x)
+                        out[x] = table[in[x]];
+                }
+
+            } else if constexpr (C::has_alpha) {
+
+                for (int y = 0; y < shape().y(); ++y)
+                    fill_row<C, Image<C, F>::is_premultiplied>(&(*this)[{0, y}], &image[{0, y}], width, foreground, background);
+
+            } else {
+
+                for (int y = 0; y < shape().y(); ++y) {
+                    auto in = &(*this)[{0, y}];
+                    auto out = &image[{0, y}];
+                    for (size_t x = 0; x < width; ++x)
+                        out[x] = blend(foreground, background, in[x], pma);
+                }
+
+            }
+
+        }
+
+        // Fill a row of pixels from a row of continuous mask values. In
+        // premultiplied form each output pixel is a linear function of the
+        // mask value, so only the division by the result alpha (for straight
+        // alpha output) varies between pixels.
+
+        template <typename T>
+        template <typename C, bool Premultiplied>
+        void ImageMask<T>::fill_row(const T* in, C* out, size_t width, C foreground, C background) noexcept {
+
+            using value_type = typename C::value_type;
+            using alpha_type = std::conditional_t<(sizeof(value_type) < sizeof(double)), float, double>;
+
+            static constexpr int channels = C::channels;
+            static constexpr int alpha_index = C::alpha_index;
+            static constexpr alpha_type colour_scale = alpha_type(C::scale);
+            static constexpr alpha_type inverse_colour_scale = 1 / colour_scale;
+            static constexpr alpha_type inverse_mask_scale = 1 / alpha_type(scale);
+
+            alpha_type fg_alpha = alpha_type(foreground.alpha()) * inverse_colour_scale;
+            alpha_type bg_alpha = alpha_type(background.alpha()) * inverse_colour_scale;
+            alpha_type base[channels];
+            alpha_type slope[channels];
+
+            for (int i = 0; i < channels; ++i) {
+                alpha_type fg = alpha_type(foreground[i]) * inverse_colour_scale;
+                alpha_type bg = alpha_type(background[i]) * inverse_colour_scale;
+                if (i != alpha_index) {
+                    fg *= fg_alpha;
+                    bg *= bg_alpha;
+                }
+                base[i] = bg;
+                slope[i] = fg - fg_alpha * bg;
+            }
+
+            alpha_type value[channels];
+
+            for (size_t x = 0; x < width; ++x) {
+
+                alpha_type a = alpha_type(in[x]) * inverse_mask_scale;
 
-            for (T alpha: *this)
-                *out++ = blend(foreground, background, alpha, pma);
+                for (int i = 0; i < channels; ++i)
+                    value[i] = base[i] + a * slope[i];
+
+                alpha_type divisor = 1;
+                if (! Premultiplied && value[alpha_index] != 0)
+                    divisor = 1 / value[alpha_index];
+
+                for (int i = 0; i < channels; ++i) {
+                    alpha_type v = i == alpha_index ? value[i] : value[i] * divisor;
+                    if constexpr (std::is_floating_point_v<value_type>)
+                        out[x][i] = value_type(v * colour_scale);
+                    else
+                        out[x][i] = value_type(std::clamp(v, alpha_type(0), alpha_type(1)) * colour_scale + alpha_type(0.5));
+                }
+
+            }
 
         }
 
         template <typename T>
         template <typename C, ImageFlags F>
         void ImageMask<T>::onto_image(Image<C, F>& image, Point offset, C colour) const {
+            onto_image(image, offset, colour, Core::Box_i2(Point::null(), image.shape()));
+        }
+
+        template <typename T>
+        template <typename C, ImageFlags F>
+        void ImageMask<T>::onto_image(Image<C, F>& image, Point offset, C colour, const Core::Box_i2& clip) const {
 
             static_assert(C::is_linear);
 
@@ -90,22 +195,103 @@ namespace RS::Graphics::Plane::Detail {
 
             static constexpr Core::Pma pma = Image<C, F>::is_premultiplied ? Core::Pma::second | Core::Pma::result : Core::Pma::none;
 
-            int mask_x1 = std::max(0, - offset.x());
-            int mask_y1 = std::max(0, - offset.y());
-            int mask_x2 = std::min(shape().x(), image.width() - offset.x());
-            int mask_y2 = std::min(shape().y(), image.height() - offset.y());
+            int clip_x1 = std::max(0, clip.base().x());
+            int clip_y1 = std::max(0, clip.base().y());
+            int clip_x2 = std::min(image.width(), clip.apex().x());
+            int clip_y2 = std::min(image.height(), clip.apex().y());
+            int mask_x1 = std::max(0, clip_x1 - offset.x());
+            int mask_y1 = std::max(0, clip_y1 - offset.y());
+            int mask_x2 = std::min(shape().x(), clip_x2 - offset.x());
+            int mask_y2 = std::min(shape().y(), clip_y2 - offset.y());
 
             if (mask_x1 >= mask_x2 || mask_y1 >= mask_y2)
                 return;
 
             int image_x1 = mask_x1 + offset.x();
             int image_y1 = mask_y1 + offset.y();
-            Point p; // point on mask
-            Point q; // point on image
+            auto width = size_t(mask_x2 - mask_x1);
 
-            for (p.y() = mask_y1, q.y() = image_y1; p.y() < mask_y2; ++p.y(), ++q.y())
-                for (p.x() = mask_x1, q.x() = image_x1; p.x() < mask_x2; ++p.x(), ++q.x())
-                    image[q] = blend(colour, image[q], (*this)[p], pma);
+            for (int mask_y = mask_y1, image_y = image_y1; mask_y < mask_y2; ++mask_y, ++image_y) {
+
+                auto in = &(*this)[{mask_x1, mask_y}];
+                auto out = &image[{image_x1, image_y}];
+
+                if constexpr (C::has_alpha) {
+                    blend_row<C, Image<C, F>::is_premultiplied>(in, out, width, colour);
+                } else {
+                    for (size_t x = 0; x < width; ++x)
+                        if (in[x] != 0)
+                            out[x] = blend(colour, out[x], in[x], pma);
+                }
+
+            }
+
+        }
+
+        // Blend a row of mask values into a row of pixels, using the
+        // colour at full coverage. Zero coverage pixels are skipped, and
+        // full coverage of an opaque colour is a direct store. The rest are
+        // blended channel by channel in premultiplied form, with no
+        // branching inside the loop over channels.
+
+        template <typename T>
+        template <typename C, bool Premultiplied>
+        void ImageMask<T>::blend_row(const T* in, C* out, size_t width, C colour) noexcept {
+
+            using value_type = typename C::value_type;
+            using alpha_type = std::conditional_t<(sizeof(value_type) < sizeof(double)), float, double>;
+
+            static constexpr int channels = C::channels;
+            static constexpr int alpha_index = C::alpha_index;
+            static constexpr alpha_type colour_scale = alpha_type(C::scale);
+            static constexpr alpha_type inverse_colour_scale = 1 / colour_scale;
+            static constexpr alpha_type inverse_mask_scale = 1 / alpha_type(scale);
+
+            alpha_type fg[channels];
+            for (int i = 0; i < channels; ++i)
+                fg[i] = alpha_type(colour[i]) * inverse_colour_scale;
+            alpha_type fg_alpha = fg[alpha_index];
+            fg[alpha_index] = 1;
+
+            bool opaque = colour.alpha() == C::scale;
+            alpha_type weight[channels];
+            alpha_type divisor[channels];
+
+            for (size_t x = 0; x < width; ++x) {
+
+                T m = in[x];
+
+                if (m == 0)
+                    continue;
+
+                if (m == scale && opaque) {
+                    out[x] = colour;
+                    continue;
+                }
+
+                auto& pixel = out[x];
+                alpha_type a = alpha_type(m) * inverse_mask_scale * fg_alpha;
+                alpha_type k = 1 - a;
+                alpha_type bg_alpha = alpha_type(pixel.alpha()) * inverse_colour_scale;
+                alpha_type result_alpha = a + bg_alpha * k;
+
+                for (int i = 0; i < channels; ++i) {
+                    weight[i] = Premultiplied ? k : bg_alpha * k;
+                    divisor[i] = Premultiplied || result_alpha == 0 ? 1 : result_alpha;
+                }
+
+                weight[alpha_index] = k;
+                divisor[alpha_index] = 1;
+
+                for (int i = 0; i < channels; ++i) {
+                    alpha_type value = (fg[i] * a + alpha_type(pixel[i]) * inverse_colour_scale * weight[i]) / divisor[i];
+                    if constexpr (std::is_floating_point_v<value_type>)
+                        pixel[i] = value_type(value * colour_scale);
+                    else
+                        pixel[i] = value_type(std::min(value, alpha_type(1)) * colour_scale + alpha_type(0.5));
+                }
+
+            }
 
         }
 
@@ -126,16 +312,12 @@ namespace RS::Graphics::Plane::Detail {
                 if constexpr (std::is_floating_point_v<value_type>)
                     fga2 = value_type(fga1);
                 else
-                    fga2 = value_type(alpha_type(C::scale) * fga1 + alpha_type(0.5));
+                    fga2 = value_type(fga1 + alpha_type(0.5));
 
                 C modified_fg = fg;
                 modified_fg.alpha() = fga2;
-                C result = alpha_blend(modified_fg, bg);
-
-                if (!! pma)
-                    result.multiply_alpha();
 
-                return result;
+                return alpha_blend(modified_fg, bg, pma);
 
             } else {
 
@@ -145,4 +327,173 @@ namespace RS::Graphics::Plane::Detail {
 
         }
 
+
+    // Mask stored as runs of non-zero values. Spans are kept in row order,
+    // and in order of x within each row, and never overlap.
+
+    template <typename T>
+    class SparseMask {
+
+    public:
+
+        using value_type = T;
+
+        SparseMask() = default;
+        explicit SparseMask(Point shape) noexcept: shape_(shape) {}
+        explicit SparseMask(const ImageMask<T>& mask);
+
+        bool empty() const noexcept { return shape_.x() <= 0 || shape_.y() <= 0; }
+        Point shape() const noexcept { return shape_; }
+        size_t spans() const noexcept { return spans_.size(); }
+        size_t covered() const noexcept { return values_.size(); }
+
+        void append_row(int y, int x, const T* row, int width);
+
+        template <typename C, ImageFlags F> void make_image(Image<C, F>& image, C foreground, C background) const;
+        template <typename C, ImageFlags F> void onto_image(Image<C, F>& image, Point offset, C colour) const;
+        template <typename C, ImageFlags F> void onto_image(Image<C, F>& image, Point offset, C colour, const Core::Box_i2& clip) const;
+
+    private:
+
+        using dense_type = ImageMask<T>;
+
+        struct span_type {
+            int x;
+            int y;
+            int length;
+            size_t offset; // Index of first value
+        };
+
+        Point shape_;
+        std::vector<span_type> spans_;
+        std::vector<T> values_;
+
+    };
+
+        using SparseByteMask = SparseMask<unsigned char>;
+
+        template <typename T>
+        SparseMask<T>::SparseMask(const ImageMask<T>& mask):
+        shape_(mask.shape()) {
+            if (! mask.empty())
+                for (int y = 0; y < shape_.y(); ++y)
+                    append_row(y, 0, &mask[{0, y}], shape_.x());
+        }
+
+        // Add the non-zero runs from part of a row. Rows must be added in
+        // order, and parts of the same row in order of x. A run that starts
+        // where the last span of the same row ends is merged into it, so a
+        // row added in parts gives the same spans as the whole row.
+
+        template <typename T>
+        void SparseMask<T>::append_row(int y, int x, const T* row, int width) {
+            int i = 0;
+            while (i < width) {
+                while (i < width && row[i] == 0)
+                    ++i;
+                int start = i;
+                while (i < width && row[i] != 0)
+                    ++i;
+                if (i > start) {
+                    if (! spans_.empty() && spans_.back().y == y && spans_.back().x + spans_.back().length == x + start)
+                        spans_.back().length += i - start;
+                    else
+                        spans_.push_back({x + start, y, i - start, values_.size()});
+                    values_.insert(values_.end(), row + start, row + i);
+                }
+            }
+        }
+
+        template <typename T>
+        template <typename C, ImageFlags F>
+        void SparseMask<T>::make_image(Image<C, F>& image, C foreground, C background) const {
+
+            static_assert(C::is_linear);
+
+            static constexpr Core::Pma pma = Image<C, F>::is_premultiplied ? Core::Pma::result : Core::Pma::none;
+
+            image.reset(shape(), dense_type::blend(foreground, background, T(0), pma));
+
+            if constexpr (std::is_same_v<T, unsigned char>) {
+
+                std::array<C, 256> table;
+                for (int i = 0; i < 256; ++i)
+                    table[i] = dense_type::blend(foreground, background, T(i), pma);
+
+                for (auto& span: spans_) {
+                    auto in = values_.data() + span.offset;
+                    auto out = &image[{span.x, span.y}];
+                    for (int x = 0; x < span.length; ++x)
+                        out[x] = table[in[x]];
+                }
+
+            } else if constexpr (C::has_alpha) {
+
+                for (auto& span: spans_)
+                    dense_type::template fill_row<C, Image<C, F>::is_premultiplied>(values_.data() + span.offset,
+                        &image[{span.x, span.y}], size_t(span.length), foreground, background);
+
+            } else {
+
+                for (auto& span: spans_) {
+                    auto in = values_.data() + span.offset;
+                    auto out = &image[{span.x, span.y}];
+                    for (int x = 0; x < span.length; ++x)
+                        out[x] = dense_type::blend(foreground, background, in[x], pma);
+                }
+
+            }
+
+        }
+
+        template <typename T>
+        template <typename C, ImageFlags F>
+        void SparseMask<T>::onto_image(Image<C, F>& image, Point offset, C colour) const {
+            onto_image(image, offset, colour, Core::Box_i2(Point::null(), image.shape()));
+        }
+
+        template <typename T>
+        template <typename C, ImageFlags F>
+        void SparseMask<T>::onto_image(Image<C, F>& image, Point offset, C colour, const Core::Box_i2& clip) const {
+
+            static_assert(C::is_linear);
+
+            static constexpr Core::Pma pma = Image<C, F>::is_premultiplied ? Core::Pma::second | Core::Pma::result : Core::Pma::none;
+
+            int clip_x1 = std::max(0, clip.base().x());
+            int clip_y1 = std::max(0, clip.base().y());
+            int clip_x2 = std::min(image.width(), clip.apex().x());
+            int clip_y2 = std::min(image.height(), clip.apex().y());
+
+            // Spans are sorted by row, so skip straight to the first visible row
+
+            auto it = std::lower_bound(spans_.begin(), spans_.end(), clip_y1 - offset.y(),
+                [] (const span_type& span, int y) { return span.y < y; });
+
+            for (; it != spans_.end(); ++it) {
+
+                int y = it->y + offset.y();
+                if (y >= clip_y2)
+                    break;
+
+                int x1 = std::max(it->x + offset.x(), clip_x1);
+                int x2 = std::min(it->x + it->length + offset.x(), clip_x2);
+                if (x1 >= x2)
+                    continue;
+
+                auto in = values_.data() + it->offset + (x1 - it->x - offset.x());
+                auto out = &image[{x1, y}];
+                auto width = size_t(x2 - x1);
+
+                if constexpr (C::has_alpha) {
+                    dense_type::template blend_row<C, Image<C, F>::is_premultiplied>(in, out, width, colour);
+                } else {
+                    for (size_t x = 0; x < width; ++x)
+                        out[x] = dense_type::blend(colour, out[x], in[x], pma);
+                }
+
+            }
+
+        }
+
 }
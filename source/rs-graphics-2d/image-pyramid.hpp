@@ -0,0 +1,67 @@
+#pragma once
+
+#include "rs-graphics-2d/image.hpp"
+#include "rs-graphics-core/colour.hpp"
+#include "rs-graphics-core/colour-space.hpp"
+#include <utility>
+#include <vector>
+
+namespace RS::Graphics::Plane {
+
+    template <typename C, ImageFlags F = ImageFlags::none>
+    class ImagePyramid {
+
+    public:
+
+        using image_type = Image<C, F>;
+        using const_iterator = typename std::vector<image_type>::const_iterator;
+
+        ImagePyramid() = default;
+        explicit ImagePyramid(const image_type& image, ImageResize rflags = ImageResize::none) { build(image, rflags); }
+
+        const image_type& operator[](size_t level) const noexcept { return levels_[level]; }
+        const_iterator begin() const noexcept { return levels_.begin(); }
+        const_iterator end() const noexcept { return levels_.end(); }
+
+        void build(const image_type& image, ImageResize rflags = ImageResize::none);
+        void clear() noexcept { levels_.clear(); }
+        bool empty() const noexcept { return levels_.empty(); }
+        size_t size() const noexcept { return levels_.size(); }
+
+    private:
+
+        std::vector<image_type> levels_;
+
+    };
+
+        // Levels are generated from each other in premultiplied linear light,
+        // so the input is only converted once, and each output level once.
+
+        template <typename C, ImageFlags F>
+        void ImagePyramid<C, F>::build(const image_type& image, ImageResize rflags) {
+
+            using working_colour = Core::Colour<float, Core::LinearRGB, image_type::colour_layout>;
+            using working_image = Image<working_colour, image_type::has_alpha ? F | ImageFlags::premultiplied : F>;
+
+            levels_.clear();
+
+            if (image.empty())
+                return;
+
+            bool use_parallel = !! (rflags & ImageResize::parallel);
+            levels_.push_back(image);
+            working_image current;
+            convert_image(image, current);
+
+            while (current.width() > 1 || current.height() > 1) {
+                working_image next((current.width() + 1) / 2, (current.height() + 1) / 2);
+                Detail::downsample_image_2x2(current.data(), current.shape(), next.data(), working_colour::channels, use_parallel);
+                image_type level;
+                convert_image(next, level);
+                levels_.push_back(std::move(level));
+                current = std::move(next);
+            }
+
+        }
+
+}
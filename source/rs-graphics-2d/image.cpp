@@ -1,4 +1,7 @@
 #include "rs-graphics-2d/image.hpp"
+#include <cmath>
+#include <limits>
+#include <thread>
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_STATIC
@@ -6,10 +9,39 @@
 #define STBI_WINDOWS_UTF8
 #define STB_IMAGE_RESIZE_IMPLEMENTATION
 #define STB_IMAGE_RESIZE_STATIC
+#define STBIR_MALLOC(size, context) RS::Graphics::Plane::Detail::resize_scratch_alloc((size), (context))
+#define STBIR_FREE(ptr, context) RS::Graphics::Plane::Detail::resize_scratch_free((ptr), (context))
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_STATIC
 #define STBIW_WINDOWS_UTF8
 
+// Resize working memory comes from the caller's scratch buffer when one is
+// supplied, and is only reallocated when a larger buffer is needed
+
+namespace RS::Graphics::Plane::Detail {
+
+    namespace {
+
+        void* resize_scratch_alloc(size_t size, void* context) noexcept {
+            if (context == nullptr)
+                return std::malloc(size);
+            auto& scratch = *static_cast<ResizeScratch*>(context);
+            if (scratch.bytes < size) {
+                scratch.ptr.reset(static_cast<unsigned char*>(std::malloc(size)));
+                scratch.bytes = scratch.ptr ? size : 0;
+            }
+            return scratch.ptr.get();
+        }
+
+        void resize_scratch_free(void* ptr, void* context) noexcept {
+            if (context == nullptr)
+                std::free(ptr);
+        }
+
+    }
+
+}
+
 #if defined(__aarch64__) || defined(_M_ARM64)
     #define STBI_NEON
 #endif
@@ -145,31 +177,638 @@ namespace RS::Graphics::Plane {
                 throw ImageIoError(file, {}, false);
         }
 
+        namespace {
+
+            constexpr int min_resize_band = 32;
+
+            size_t count_bands(int rows, bool parallel) noexcept {
+                if (! parallel)
+                    return 1;
+                size_t max_bands = size_t(std::max(rows / min_resize_band, 1));
+                return std::min(max_bands, size_t(std::max(std::thread::hardware_concurrency(), 1u)));
+            }
+
+            // Calls f(i, y1, y2) for each band of rows, with each band after
+            // the first on its own thread. Returns false if any call did.
+
+            template <typename F>
+            bool for_each_band(int rows, size_t num_bands, F f) {
+                auto run_band = [rows, num_bands, &f] (size_t i) {
+                    int y1 = int(i * size_t(rows) / num_bands);
+                    int y2 = int((i + 1) * size_t(rows) / num_bands);
+                    return f(i, y1, y2);
+                };
+                if (num_bands == 1)
+                    return run_band(0);
+                std::vector<char> results(num_bands, 0);
+                std::vector<std::thread> threads;
+                for (size_t i = 1; i < num_bands; ++i)
+                    threads.emplace_back([&results, &run_band, i] { results[i] = run_band(i); });
+                results[0] = run_band(0);
+                for (auto& t: threads)
+                    t.join();
+                return std::all_of(results.begin(), results.end(), [] (char c) { return c != 0; });
+            }
+
+            // Split the output rows into bands and resize each band on its
+            // own thread. Each band uses the same scale factors as the whole
+            // image, with the vertical offset of its first row, so the result
+            // is identical to a single call.
+
+            void resize_image(const void* in, Point ishape, void* out, Point oshape, stbir_datatype type, size_t channel_size,
+                    int num_channels, int alpha_channel, int stb_flags, int stb_edge, int h_filter, int v_filter, int stb_space,
+                    bool parallel, ResizeScratchList& scratch) {
+
+                float x_scale = float(oshape.x()) / float(ishape.x());
+                float y_scale = float(oshape.y()) / float(ishape.y());
+                size_t row_bytes = size_t(oshape.x()) * size_t(num_channels) * channel_size;
+                size_t num_bands = count_bands(oshape.y(), parallel);
+
+                if (scratch.size() < num_bands)
+                    scratch.resize(num_bands);
+
+                bool ok = for_each_band(oshape.y(), num_bands, [&] (size_t i, int y1, int y2) {
+                    return stbir_resize_subpixel(in, ishape.x(), ishape.y(), 0,
+                        static_cast<unsigned char*>(out) + size_t(y1) * row_bytes, oshape.x(), y2 - y1, 0,
+                        type, num_channels, alpha_channel, stb_flags, stbir_edge(stb_edge), stbir_edge(stb_edge),
+                        stbir_filter(h_filter), stbir_filter(v_filter), stbir_colorspace(stb_space), &scratch[i],
+                        x_scale, y_scale, 0.0f, float(y1)) != 0;
+                });
+
+                if (! ok)
+                    throw std::invalid_argument("Internal error: image resize failed");
+
+            }
+
+            constexpr double pi = 3.14159265358979323846;
+
+            double sinc(double x) noexcept {
+                if (x == 0)
+                    return 1;
+                x *= pi;
+                return std::sin(x) / x;
+            }
+
+            // Cubic filters in the Mitchell-Netravali family
+
+            double cubic_kernel(double x, double b, double c) noexcept {
+                x = std::abs(x);
+                if (x < 1)
+                    return ((12 - 9 * b - 6 * c) * x * x * x + (-18 + 12 * b + 6 * c) * x * x + (6 - 2 * b)) / 6;
+                if (x < 2)
+                    return ((- b - 6 * c) * x * x * x + (6 * b + 30 * c) * x * x + (-12 * b - 48 * c) * x + (8 * b + 24 * c)) / 6;
+                return 0;
+            }
+
+            double filter_support(ImageFilter filter) noexcept {
+                switch (filter) {
+                    case ImageFilter::triangle:  return 1;
+                    case ImageFilter::lanczos3:  return 3;
+                    default:                     return 2;
+                }
+            }
+
+            double filter_kernel(ImageFilter filter, double x) noexcept {
+                switch (filter) {
+                    case ImageFilter::triangle:     return std::max(1 - std::abs(x), 0.0);
+                    case ImageFilter::bspline:      return cubic_kernel(x, 1, 0);
+                    case ImageFilter::catmull_rom:  return cubic_kernel(x, 0, 0.5);
+                    case ImageFilter::mitchell:     return cubic_kernel(x, 1.0 / 3, 1.0 / 3);
+                    case ImageFilter::lanczos3:     return std::abs(x) < 3 ? sinc(x) * sinc(x / 3) : 0;
+                    default:                        return 0;
+                }
+            }
+
+            // Weights for one axis, with a fixed number of taps per output
+            // pixel. Source indices are already mapped through the edge mode.
+
+            void make_resample_filter(ResampleFilter& rf) {
+
+                // The box filter averages over the output pixel's footprint,
+                // as stb_image_resize does, rather than point sampling
+
+                auto filter = ImageFilter(rf.filter);
+                double scale = double(rf.out_size) / double(rf.in_size);
+                double stretch = std::max(1 / scale, 1.0);
+                double half_box = 0.5 / scale;
+                double support = filter == ImageFilter::box ? 0.5 + half_box : filter_support(filter) * stretch;
+                rf.taps = int(std::ceil(2 * support)) + 1;
+                rf.index.assign(size_t(rf.out_size) * size_t(rf.taps), 0);
+                rf.weight.assign(size_t(rf.out_size) * size_t(rf.taps), 0);
+
+                for (int i = 0; i < rf.out_size; ++i) {
+
+                    double centre = (i + 0.5) / scale - 0.5;
+                    int first = int(std::ceil(centre - support));
+                    auto index = rf.index.data() + size_t(i) * size_t(rf.taps);
+                    auto weight = rf.weight.data() + size_t(i) * size_t(rf.taps);
+                    double sum = 0;
+
+                    for (int k = 0; k < rf.taps; ++k) {
+                        int j = first + k;
+                        double w;
+                        if (filter == ImageFilter::box)
+                            w = std::max(std::min(j + 0.5, centre + half_box) - std::max(j - 0.5, centre - half_box), 0.0);
+                        else
+                            w = filter_kernel(filter, (j - centre) / stretch);
+                        if (rf.wrap)
+                            j = ((j % rf.in_size) + rf.in_size) % rf.in_size;
+                        else
+                            j = std::clamp(j, 0, rf.in_size - 1);
+                        index[k] = j;
+                        weight[k] = float(w);
+                        sum += w;
+                    }
+
+                    if (sum != 0)
+                        for (int k = 0; k < rf.taps; ++k)
+                            weight[k] = float(weight[k] / sum);
+
+                }
+
+            }
+
+            std::shared_ptr<const ResampleFilter> get_resample_filter(ResampleCache& cache, int in_size, int out_size,
+                    int filter, bool wrap) {
+
+                static constexpr size_t max_cache_size = 16;
+
+                for (auto& rf: cache)
+                    if (rf->in_size == in_size && rf->out_size == out_size && rf->filter == filter && rf->wrap == wrap)
+                        return rf;
+
+                if (cache.size() >= max_cache_size)
+                    cache.erase(cache.begin());
+
+                auto rf = std::make_shared<ResampleFilter>();
+                rf->in_size = in_size;
+                rf->out_size = out_size;
+                rf->filter = filter;
+                rf->wrap = wrap;
+                make_resample_filter(*rf);
+                cache.push_back(rf);
+
+                return rf;
+
+            }
+
+            // Channel decoding for the integer ratio reduction goes through
+            // lookup tables for the integer types, one per channel, so the
+            // inner loops have no branches
+
+            float srgb_to_linear(float x) noexcept {
+                return x <= 0.04045f ? x / 12.92f : std::pow((x + 0.055f) / 1.055f, 2.4f);
+            }
+
+            float linear_to_srgb(float x) noexcept {
+                return x <= 0.0031308f ? 12.92f * x : 1.055f * std::pow(x, 1 / 2.4f) - 0.055f;
+            }
+
+            template <typename T, bool Srgb>
+            const float* decode_table() {
+                static const std::vector<float> table = [] {
+                    constexpr size_t n = size_t(std::numeric_limits<T>::max()) + 1;
+                    constexpr float scale = float(n - 1);
+                    std::vector<float> t(n);
+                    for (size_t i = 0; i < n; ++i)
+                        t[i] = Srgb ? srgb_to_linear(float(i) / scale) : float(i) / scale;
+                    return t;
+                }();
+                return table.data();
+            }
+
+            template <typename T>
+            class ChannelCodec {
+
+            public:
+
+                ChannelCodec(int num_channels, int alpha_channel, bool srgb):
+                srgb_(size_t(num_channels)), tables_(size_t(num_channels), nullptr) {
+                    for (int c = 0; c < num_channels; ++c) {
+                        srgb_[size_t(c)] = srgb && c != alpha_channel;
+                        if constexpr (! std::is_floating_point_v<T>)
+                            tables_[size_t(c)] = srgb_[size_t(c)] ? decode_table<T, true>() : decode_table<T, false>();
+                    }
+                }
+
+                float decode(T x, size_t c) const noexcept {
+                    if constexpr (std::is_floating_point_v<T>)
+                        return srgb_[c] ? srgb_to_linear(float(x)) : float(x);
+                    else
+                        return tables_[c][x];
+                }
+
+                T encode(float x, size_t c) const noexcept {
+                    if (srgb_[c])
+                        x = linear_to_srgb(std::max(x, 0.0f));
+                    if constexpr (std::is_floating_point_v<T>)
+                        return T(x);
+                    else
+                        return T(std::lround(std::clamp(x, 0.0f, 1.0f) * scale));
+                }
+
+            private:
+
+                static constexpr float scale = std::is_floating_point_v<T> ? 1.0f : float(std::numeric_limits<T>::max());
+
+                std::vector<char> srgb_;
+                std::vector<const float*> tables_;
+
+            };
+
+            // Exact integer ratio reduction: each output pixel is the average
+            // of a block of input pixels, accumulated in linear light. Colour
+            // channels are weighted by alpha unless the data is already
+            // premultiplied, which gives the same result as the resampler.
+            // Input rows are summed first, then each block of columns. NC is
+            // the channel count if known at compile time, otherwise zero.
+
+            template <typename T, size_t NC>
+            void reduce_image(const T* in, Point ishape, T* out, Point oshape, int num_channels, int alpha_channel,
+                    bool premultiplied, bool srgb, bool parallel) {
+
+                ChannelCodec<T> codec(num_channels, alpha_channel, srgb);
+                const size_t nc = NC != 0 ? NC : size_t(num_channels);
+                int fx = ishape.x() / oshape.x();
+                int fy = ishape.y() / oshape.y();
+                size_t in_row = size_t(ishape.x()) * nc;
+                size_t out_row = size_t(oshape.x()) * nc;
+                size_t block = size_t(fx) * nc;
+                bool weighted = alpha_channel >= 0 && ! premultiplied;
+                size_t ac = weighted ? size_t(alpha_channel) : 0;
+                float norm = 1.0f / float(fx * fy);
+
+                for_each_band(oshape.y(), count_bands(oshape.y(), parallel), [&] (size_t, int y1, int y2) {
+
+                    std::vector<float> column(in_row);
+                    std::vector<float> acc(nc);
+
+                    for (int y = y1; y < y2; ++y) {
+
+                        std::fill(column.begin(), column.end(), 0.0f);
+
+                        for (int dy = 0; dy < fy; ++dy) {
+                            auto src = in + size_t(y * fy + dy) * in_row;
+                            if (weighted) {
+                                for (size_t i = 0; i < in_row; i += nc) {
+                                    float alpha = codec.decode(src[i + ac], ac);
+                                    for (size_t c = 0; c < nc; ++c)
+                                        column[i + c] += codec.decode(src[i + c], c) * (c == ac ? 1.0f : alpha);
+                                }
+                            } else {
+                                for (size_t i = 0; i < in_row; i += nc)
+                                    for (size_t c = 0; c < nc; ++c)
+                                        column[i + c] += codec.decode(src[i + c], c);
+                            }
+                        }
+
+                        auto dst = out + size_t(y) * out_row;
+
+                        for (size_t x = 0; x < out_row; x += nc) {
+                            auto src = column.data() + x / nc * block;
+                            std::fill(acc.begin(), acc.end(), 0.0f);
+                            for (size_t i = 0; i < block; i += nc)
+                                for (size_t c = 0; c < nc; ++c)
+                                    acc[c] += src[i + c];
+                            for (size_t c = 0; c < nc; ++c) {
+                                float value = acc[c];
+                                if (weighted && c != ac)
+                                    value = acc[ac] > 0 ? value / acc[ac] : 0;
+                                else
+                                    value *= norm;
+                                dst[x + c] = codec.encode(value, c);
+                            }
+                        }
+
+                    }
+
+                    return true;
+
+                });
+
+            }
+
+            // Integer data that needs neither decoding nor alpha weighting can
+            // be summed exactly without converting to floating point
+
+            template <typename T, size_t NC>
+            void reduce_image_integer(const T* in, Point ishape, T* out, Point oshape, int num_channels, bool parallel) {
+
+                // Column and block sums are 64 bits, which no image can
+                // overflow. With 32 bit column sums, 8 bit data would overflow
+                // for blocks taller than 16843009 rows, and 16 bit data for
+                // blocks taller than 65537.
+
+                using column_type = uint64_t;
+                using block_type = uint64_t;
+
+                const size_t nc = NC != 0 ? NC : size_t(num_channels);
+                int fx = ishape.x() / oshape.x();
+                int fy = ishape.y() / oshape.y();
+                size_t in_row = size_t(ishape.x()) * nc;
+                size_t out_row = size_t(oshape.x()) * nc;
+                size_t block = size_t(fx) * nc;
+                auto count = block_type(fx) * block_type(fy);
+
+                for_each_band(oshape.y(), count_bands(oshape.y(), parallel), [&] (size_t, int y1, int y2) {
+
+                    std::vector<column_type> column(in_row);
+                    std::vector<block_type> acc(nc);
+
+                    for (int y = y1; y < y2; ++y) {
+
+                        std::fill(column.begin(), column.end(), 0);
+
+                        for (int dy = 0; dy < fy; ++dy) {
+                            auto src = in + size_t(y * fy + dy) * in_row;
+                            for (size_t i = 0; i < in_row; ++i)
+                                column[i] += src[i];
+                        }
+
+                        auto dst = out + size_t(y) * out_row;
+
+                        for (size_t x = 0; x < out_row; x += nc) {
+                            auto src = column.data() + x / nc * block;
+                            std::fill(acc.begin(), acc.end(), 0);
+                            for (size_t i = 0; i < block; i += nc)
+                                for (size_t c = 0; c < nc; ++c)
+                                    acc[c] += src[i + c];
+                            for (size_t c = 0; c < nc; ++c)
+                                dst[x + c] = T((acc[c] + count / 2) / count);
+                        }
+
+                    }
+
+                    return true;
+
+                });
+
+            }
+
+            template <typename T>
+            void reduce_image(const T* in, Point ishape, T* out, Point oshape, int num_channels, int alpha_channel,
+                    bool premultiplied, bool srgb, bool parallel) {
+                if constexpr (! std::is_floating_point_v<T>) {
+                    bool exact = ! srgb && (alpha_channel < 0 || premultiplied);
+                    if (exact) {
+                        if (num_channels == 4)
+                            reduce_image_integer<T, 4>(in, ishape, out, oshape, num_channels, parallel);
+                        else
+                            reduce_image_integer<T, 0>(in, ishape, out, oshape, num_channels, parallel);
+                        return;
+                    }
+                }
+                if (num_channels == 4)
+                    reduce_image<T, 4>(in, ishape, out, oshape, num_channels, alpha_channel, premultiplied, srgb, parallel);
+                else if (num_channels == 3)
+                    reduce_image<T, 3>(in, ishape, out, oshape, num_channels, alpha_channel, premultiplied, srgb, parallel);
+                else
+                    reduce_image<T, 0>(in, ishape, out, oshape, num_channels, alpha_channel, premultiplied, srgb, parallel);
+            }
+
+        }
+
         void resize_image_8(const uint8_t* in, Point ishape, uint8_t* out, Point oshape, int num_channels, int alpha_channel,
-                int stb_flags, int stb_edge, int stb_filter, int stb_space) {
-            int rc = stbir_resize_uint8_generic(in, ishape.x(), ishape.y(), 0, out, oshape.x(), oshape.y(), 0,
-                num_channels, alpha_channel, stb_flags, stbir_edge(stb_edge), stbir_filter(stb_filter),
-                stbir_colorspace(stb_space), nullptr);
-            if (rc == 0)
-                throw std::invalid_argument("Internal error: image resize failed");
+                int stb_flags, int stb_edge, int h_filter, int v_filter, int stb_space, bool parallel, ResizeScratchList& scratch) {
+            resize_image(in, ishape, out, oshape, STBIR_TYPE_UINT8, sizeof(uint8_t), num_channels, alpha_channel,
+                stb_flags, stb_edge, h_filter, v_filter, stb_space, parallel, scratch);
         }
 
         void resize_image_16(const uint16_t* in, Point ishape, uint16_t* out, Point oshape, int num_channels, int alpha_channel,
-                int stb_flags, int stb_edge, int stb_filter, int stb_space) {
-            int rc = stbir_resize_uint16_generic(in, ishape.x(), ishape.y(), 0, out, oshape.x(), oshape.y(), 0,
-                num_channels, alpha_channel, stb_flags, stbir_edge(stb_edge), stbir_filter(stb_filter),
-                stbir_colorspace(stb_space), nullptr);
-            if (rc == 0)
-                throw std::invalid_argument("Internal error: image resize failed");
+                int stb_flags, int stb_edge, int h_filter, int v_filter, int stb_space, bool parallel, ResizeScratchList& scratch) {
+            resize_image(in, ishape, out, oshape, STBIR_TYPE_UINT16, sizeof(uint16_t), num_channels, alpha_channel,
+                stb_flags, stb_edge, h_filter, v_filter, stb_space, parallel, scratch);
         }
 
         void resize_image_hdr(const float* in, Point ishape, float* out, Point oshape, int num_channels, int alpha_channel,
-                int stb_flags, int stb_edge, int stb_filter, int stb_space) {
-            int rc = stbir_resize_float_generic(in, ishape.x(), ishape.y(), 0, out, oshape.x(), oshape.y(), 0,
-                num_channels, alpha_channel, stb_flags, stbir_edge(stb_edge), stbir_filter(stb_filter),
-                stbir_colorspace(stb_space), nullptr);
-            if (rc == 0)
-                throw std::invalid_argument("Internal error: image resize failed");
+                int stb_flags, int stb_edge, int h_filter, int v_filter, int stb_space, bool parallel, ResizeScratchList& scratch) {
+            resize_image(in, ishape, out, oshape, STBIR_TYPE_FLOAT, sizeof(float), num_channels, alpha_channel,
+                stb_flags, stb_edge, h_filter, v_filter, stb_space, parallel, scratch);
+        }
+
+        // Separable resampler for filters that stb_image_resize doesn't
+        // support. Works on premultiplied linear float data: a horizontal
+        // pass into a temporary buffer, then a vertical pass into the output.
+
+        void resample_image(const float* in, Point ishape, float* out, Point oshape, int num_channels, int alpha_channel,
+                int h_filter, int v_filter, bool wrap, bool parallel, ResampleCache& cache) {
+
+            auto hf_ptr = get_resample_filter(cache, ishape.x(), oshape.x(), h_filter, wrap);
+            auto vf_ptr = get_resample_filter(cache, ishape.y(), oshape.y(), v_filter, wrap);
+            auto& hf = *hf_ptr;
+            auto& vf = *vf_ptr;
+            size_t nc = size_t(num_channels);
+            size_t in_row = size_t(ishape.x()) * nc;
+            size_t out_row = size_t(oshape.x()) * nc;
+            std::vector<float> buffer(size_t(ishape.y()) * out_row);
+
+            for_each_band(ishape.y(), count_bands(ishape.y(), parallel), [&] (size_t, int y1, int y2) {
+                for (int y = y1; y < y2; ++y) {
+                    auto src = in + size_t(y) * in_row;
+                    auto dst = buffer.data() + size_t(y) * out_row;
+                    for (int x = 0; x < oshape.x(); ++x, dst += nc) {
+                        auto index = hf.index.data() + size_t(x) * size_t(hf.taps);
+                        auto weight = hf.weight.data() + size_t(x) * size_t(hf.taps);
+                        std::fill(dst, dst + nc, 0.0f);
+                        for (int k = 0; k < hf.taps; ++k) {
+                            auto pixel = src + size_t(index[k]) * nc;
+                            for (size_t c = 0; c < nc; ++c)
+                                dst[c] += weight[k] * pixel[c];
+                        }
+                    }
+                }
+                return true;
+            });
+
+            // Negative lobes can push values out of range, so clamp alpha to
+            // the unit interval and colour channels to non-negative values
+
+            for_each_band(oshape.y(), count_bands(oshape.y(), parallel), [&] (size_t, int y1, int y2) {
+                for (int y = y1; y < y2; ++y) {
+                    auto index = vf.index.data() + size_t(y) * size_t(vf.taps);
+                    auto weight = vf.weight.data() + size_t(y) * size_t(vf.taps);
+                    auto dst = out + size_t(y) * out_row;
+                    std::fill(dst, dst + out_row, 0.0f);
+                    for (int k = 0; k < vf.taps; ++k) {
+                        auto src = buffer.data() + size_t(index[k]) * out_row;
+                        for (size_t i = 0; i < out_row; ++i)
+                            dst[i] += weight[k] * src[i];
+                    }
+                    for (size_t i = 0; i < out_row; ++i) {
+                        if (alpha_channel >= 0 && i % nc == size_t(alpha_channel))
+                            dst[i] = std::clamp(dst[i], 0.0f, 1.0f);
+                        else
+                            dst[i] = std::max(dst[i], 0.0f);
+                    }
+                }
+                return true;
+            });
+
+        }
+
+        // Average each 2x2 block of pixels. The output is half the size,
+        // rounded up; an odd last row or column is averaged with itself. The
+        // two rows are summed first so both loops run over contiguous data.
+
+        void downsample_image_2x2(const float* in, Point ishape, float* out, int num_channels, bool parallel) {
+
+            int out_w = (ishape.x() + 1) / 2;
+            int out_h = (ishape.y() + 1) / 2;
+            size_t nc = size_t(num_channels);
+            size_t in_row = size_t(ishape.x()) * nc;
+            size_t out_row = size_t(out_w) * nc;
+            size_t pairs = size_t(ishape.x() / 2);
+
+            for_each_band(out_h, count_bands(out_h, parallel), [&] (size_t, int y1, int y2) {
+                std::vector<float> sum(in_row);
+                for (int y = y1; y < y2; ++y) {
+                    auto row0 = in + size_t(2 * y) * in_row;
+                    auto row1 = in + size_t(std::min(2 * y + 1, ishape.y() - 1)) * in_row;
+                    auto dst = out + size_t(y) * out_row;
+                    for (size_t i = 0; i < in_row; ++i)
+                        sum[i] = row0[i] + row1[i];
+                    for (size_t x = 0; x < pairs; ++x)
+                        for (size_t c = 0; c < nc; ++c)
+                            dst[x * nc + c] = 0.25f * (sum[2 * x * nc + c] + sum[(2 * x + 1) * nc + c]);
+                    if (ishape.x() % 2 == 1)
+                        for (size_t c = 0; c < nc; ++c)
+                            dst[pairs * nc + c] = 0.5f * sum[2 * pairs * nc + c];
+                }
+                return true;
+            });
+
+        }
+
+        void reduce_image_8(const uint8_t* in, Point ishape, uint8_t* out, Point oshape, int num_channels, int alpha_channel,
+                bool premultiplied, bool srgb, bool parallel) {
+            reduce_image(in, ishape, out, oshape, num_channels, alpha_channel, premultiplied, srgb, parallel);
+        }
+
+        void reduce_image_16(const uint16_t* in, Point ishape, uint16_t* out, Point oshape, int num_channels, int alpha_channel,
+                bool premultiplied, bool srgb, bool parallel) {
+            reduce_image(in, ishape, out, oshape, num_channels, alpha_channel, premultiplied, srgb, parallel);
+        }
+
+        void reduce_image_hdr(const float* in, Point ishape, float* out, Point oshape, int num_channels, int alpha_channel,
+                bool premultiplied, bool srgb, bool parallel) {
+            reduce_image(in, ishape, out, oshape, num_channels, alpha_channel, premultiplied, srgb, parallel);
+        }
+
+        namespace {
+
+            // Exact round(x/255) and round(x/65535) for a product of two
+            // channel values, using shifts instead of a division.
+
+            inline uint32_t divide_255(uint32_t x) noexcept {
+                x += 128;
+                return (x + (x >> 8)) >> 8;
+            }
+
+            inline uint32_t divide_65535(uint32_t x) noexcept {
+                x += 32768;
+                return (x + (x >> 16)) >> 16;
+            }
+
+            // Fixed point reciprocals of 2a for 8-bit unmultiply. The
+            // rounded quotient (510c+a)/2a is exact for all 8-bit values.
+
+            struct Reciprocal255 {
+                uint32_t table[256];
+                Reciprocal255() noexcept {
+                    table[0] = 0;
+                    for (uint64_t a = 1; a < 256; ++a)
+                        table[a] = uint32_t(((uint64_t(1) << 32) + 2 * a - 1) / (2 * a));
+                }
+            };
+
+            // Calls f(colour, alpha) for each colour channel. The common
+            // four channel layouts are unrolled so the loop vectorizes.
+
+            template <typename T, typename F>
+            void apply_alpha(const T* in, T* out, size_t pixels, int num_channels, int alpha_channel, F f) noexcept {
+                if (num_channels == 4 && alpha_channel == 3) {
+                    for (size_t i = 0; i < pixels; ++i, in += 4, out += 4) {
+                        T a = in[3];
+                        out[0] = f(in[0], a);
+                        out[1] = f(in[1], a);
+                        out[2] = f(in[2], a);
+                        out[3] = a;
+                    }
+                } else if (num_channels == 4 && alpha_channel == 0) {
+                    for (size_t i = 0; i < pixels; ++i, in += 4, out += 4) {
+                        T a = in[0];
+                        out[0] = a;
+                        out[1] = f(in[1], a);
+                        out[2] = f(in[2], a);
+                        out[3] = f(in[3], a);
+                    }
+                } else {
+                    size_t nc = size_t(num_channels);
+                    for (size_t i = 0; i < pixels; ++i, in += nc, out += nc) {
+                        T a = in[alpha_channel];
+                        for (size_t c = 0; c < nc; ++c)
+                            out[c] = int(c) == alpha_channel ? a : f(in[c], a);
+                    }
+                }
+            }
+
+        }
+
+        void multiply_alpha_8(const uint8_t* in, uint8_t* out, size_t pixels, int num_channels, int alpha_channel) noexcept {
+            apply_alpha(in, out, pixels, num_channels, alpha_channel, [] (uint8_t c, uint8_t a) {
+                return uint8_t(divide_255(uint32_t(c) * a));
+            });
+        }
+
+        void multiply_alpha_16(const uint16_t* in, uint16_t* out, size_t pixels, int num_channels, int alpha_channel) noexcept {
+            apply_alpha(in, out, pixels, num_channels, alpha_channel, [] (uint16_t c, uint16_t a) {
+                return uint16_t(divide_65535(uint32_t(c) * a));
+            });
+        }
+
+        void multiply_alpha_hdr(const float* in, float* out, size_t pixels, int num_channels, int alpha_channel) noexcept {
+            apply_alpha(in, out, pixels, num_channels, alpha_channel, [] (float c, float a) {
+                return c * a;
+            });
+        }
+
+        void unmultiply_alpha_8(const uint8_t* in, uint8_t* out, size_t pixels, int num_channels, int alpha_channel) noexcept {
+            static const Reciprocal255 recip;
+            apply_alpha(in, out, pixels, num_channels, alpha_channel, [] (uint8_t c, uint8_t a) {
+                uint64_t x = 510 * uint64_t(c) + a;
+                return uint8_t(std::min((x * recip.table[a]) >> 32, uint64_t(255)));
+            });
+        }
+
+        void unmultiply_alpha_16(const uint16_t* in, uint16_t* out, size_t pixels, int num_channels, int alpha_channel) noexcept {
+            apply_alpha(in, out, pixels, num_channels, alpha_channel, [] (uint16_t c, uint16_t a) {
+                if (a == 0)
+                    return uint16_t(0);
+                uint32_t q = (uint32_t(c) * 65535u + a / 2u) / a;
+                return uint16_t(std::min(q, 65535u));
+            });
+        }
+
+        void unmultiply_alpha_hdr(const float* in, float* out, size_t pixels, int num_channels, int alpha_channel) noexcept {
+            apply_alpha(in, out, pixels, num_channels, alpha_channel, [] (float c, float a) {
+                return a == 0 ? 0.0f : c / a;
+            });
+        }
+
+        void flip_rows(void* data, int rows, size_t row_bytes) noexcept {
+            static constexpr size_t chunk = 1024;
+            unsigned char temp[chunk];
+            auto bytes = static_cast<unsigned char*>(data);
+            for (int y1 = 0, y2 = rows - 1; y1 < y2; ++y1, --y2) {
+                auto row1 = bytes + size_t(y1) * row_bytes;
+                auto row2 = bytes + size_t(y2) * row_bytes;
+                for (size_t i = 0; i < row_bytes; i += chunk) {
+                    size_t n = std::min(chunk, row_bytes - i);
+                    std::memcpy(temp, row1 + i, n);
+                    std::memcpy(row1 + i, row2 + i, n);
+                    std::memcpy(row2 + i, temp, n);
+                }
+            }
         }
 
     }
@@ -2,6 +2,7 @@
 
 #include "rs-graphics-core/colour.hpp"
 #include "rs-graphics-core/colour-space.hpp"
+#include "rs-graphics-core/geometry.hpp"
 #include "rs-graphics-core/vector.hpp"
 #include "rs-format/format.hpp"
 #include "rs-format/string.hpp"
@@ -35,13 +36,33 @@ namespace RS::Graphics::Plane {
     RS_DEFINE_BITMASK_OPERATORS(ImageFlags)
 
     enum class ImageResize: int {
-        none    = 0,
-        unlock  = 1,
-        wrap    = 2,
+        none      = 0,
+        unlock    = 1,
+        wrap      = 2,
+        parallel  = 4,
     };
 
     RS_DEFINE_BITMASK_OPERATORS(ImageResize)
 
+    enum class ImageFilter: int {
+        automatic    = 0,
+        box          = 1,
+        triangle     = 2,
+        bspline      = 3,
+        catmull_rom  = 4,
+        mitchell     = 5,
+        lanczos3     = 6,
+    };
+
+    struct ResizeFilter {
+        ImageFilter up = ImageFilter::automatic;
+        ImageFilter down = ImageFilter::automatic;
+        ResizeFilter() = default;
+        ResizeFilter(ImageFilter filter) noexcept: up(filter), down(filter) {}
+        ResizeFilter(ImageFilter up_filter, ImageFilter down_filter) noexcept: up(up_filter), down(down_filter) {}
+        ImageFilter select(int in_size, int out_size) const noexcept { return out_size > in_size ? up : down; }
+    };
+
     class ImageIoError:
     public std::runtime_error {
     public:
@@ -83,15 +104,130 @@ namespace RS::Graphics::Plane {
         StbiPtr<float> load_image_hdr(const IO::Path& file, Point& shape);
         void save_image_8(const Image<Core::Rgba8>& image, const IO::Path& file, const std::string& format, int quality);
         void save_image_hdr(const Image<Core::Rgbaf>& image, const IO::Path& file);
+
+        struct ResizeScratch {
+            std::unique_ptr<unsigned char, TL::FreeMem> ptr;
+            size_t bytes = 0;
+        };
+
+        using ResizeScratchList = std::vector<ResizeScratch>;
+
+        struct ResampleFilter {
+            int in_size = 0;
+            int out_size = 0;
+            int filter = 0;
+            bool wrap = false;
+            int taps = 0; // Weights per output pixel
+            std::vector<int> index;
+            std::vector<float> weight;
+        };
+
+        using ResampleCache = std::vector<std::shared_ptr<const ResampleFilter>>;
+
         void resize_image_8(const uint8_t* in, Point ishape, uint8_t* out, Point oshape, int num_channels, int alpha_channel,
-            int stb_flags, int stb_edge, int stb_filter, int stb_space);
+            int stb_flags, int stb_edge, int h_filter, int v_filter, int stb_space, bool parallel, ResizeScratchList& scratch);
         void resize_image_16(const uint16_t* in, Point ishape, uint16_t* out, Point oshape, int num_channels, int alpha_channel,
-            int stb_flags, int stb_edge, int stb_filter, int stb_space);
+            int stb_flags, int stb_edge, int h_filter, int v_filter, int stb_space, bool parallel, ResizeScratchList& scratch);
         void resize_image_hdr(const float* in, Point ishape, float* out, Point oshape, int num_channels, int alpha_channel,
-            int stb_flags, int stb_edge, int stb_filter, int stb_space);
+            int stb_flags, int stb_edge, int h_filter, int v_filter, int stb_space, bool parallel, ResizeScratchList& scratch);
+        void resample_image(const float* in, Point ishape, float* out, Point oshape, int num_channels, int alpha_channel,
+            int h_filter, int v_filter, bool wrap, bool parallel, ResampleCache& cache);
+        void downsample_image_2x2(const float* in, Point ishape, float* out, int num_channels, bool parallel);
+        void reduce_image_8(const uint8_t* in, Point ishape, uint8_t* out, Point oshape, int num_channels, int alpha_channel,
+            bool premultiplied, bool srgb, bool parallel);
+        void reduce_image_16(const uint16_t* in, Point ishape, uint16_t* out, Point oshape, int num_channels, int alpha_channel,
+            bool premultiplied, bool srgb, bool parallel);
+        void reduce_image_hdr(const float* in, Point ishape, float* out, Point oshape, int num_channels, int alpha_channel,
+            bool premultiplied, bool srgb, bool parallel);
+        void multiply_alpha_8(const uint8_t* in, uint8_t* out, size_t pixels, int num_channels, int alpha_channel) noexcept;
+        void multiply_alpha_16(const uint16_t* in, uint16_t* out, size_t pixels, int num_channels, int alpha_channel) noexcept;
+        void multiply_alpha_hdr(const float* in, float* out, size_t pixels, int num_channels, int alpha_channel) noexcept;
+        void unmultiply_alpha_8(const uint8_t* in, uint8_t* out, size_t pixels, int num_channels, int alpha_channel) noexcept;
+        void unmultiply_alpha_16(const uint16_t* in, uint16_t* out, size_t pixels, int num_channels, int alpha_channel) noexcept;
+        void unmultiply_alpha_hdr(const float* in, float* out, size_t pixels, int num_channels, int alpha_channel) noexcept;
+        void flip_rows(void* data, int rows, size_t row_bytes) noexcept;
+
+        // Use memset if every byte of the colour is the same. An empty image
+        // has a null pixel pointer, which memset must not be given.
+
+        template <typename C>
+        void fill_pixels(C* out, size_t pixels, C c) noexcept {
+            if (out == nullptr || pixels == 0)
+                return;
+            auto bytes = reinterpret_cast<const unsigned char*>(&c);
+            if (std::all_of(bytes + 1, bytes + sizeof(C), [bytes] (unsigned char b) { return b == bytes[0]; }))
+                std::memset(static_cast<void*>(out), bytes[0], pixels * sizeof(C));
+            else
+                std::fill_n(out, pixels, c);
+        }
+
+        // The input and output may be the same buffer
+
+        template <typename T, typename CS, Core::ColourLayout CL>
+        void multiply_alpha_pixels(const Core::Colour<T, CS, CL>* in, Core::Colour<T, CS, CL>* out, size_t pixels) noexcept {
+            using C = Core::Colour<T, CS, CL>;
+            auto src = reinterpret_cast<const T*>(in);
+            auto dst = reinterpret_cast<T*>(out);
+            if constexpr (std::is_same_v<T, uint8_t>)
+                multiply_alpha_8(src, dst, pixels, C::channels, C::alpha_index);
+            else if constexpr (std::is_same_v<T, uint16_t>)
+                multiply_alpha_16(src, dst, pixels, C::channels, C::alpha_index);
+            else if constexpr (std::is_same_v<T, float>)
+                multiply_alpha_hdr(src, dst, pixels, C::channels, C::alpha_index);
+            else
+                for (size_t i = 0; i < pixels; ++i)
+                    out[i] = in[i].multiply_alpha();
+        }
+
+        template <typename T, typename CS, Core::ColourLayout CL>
+        void unmultiply_alpha_pixels(const Core::Colour<T, CS, CL>* in, Core::Colour<T, CS, CL>* out, size_t pixels) noexcept {
+            using C = Core::Colour<T, CS, CL>;
+            auto src = reinterpret_cast<const T*>(in);
+            auto dst = reinterpret_cast<T*>(out);
+            if constexpr (std::is_same_v<T, uint8_t>)
+                unmultiply_alpha_8(src, dst, pixels, C::channels, C::alpha_index);
+            else if constexpr (std::is_same_v<T, uint16_t>)
+                unmultiply_alpha_16(src, dst, pixels, C::channels, C::alpha_index);
+            else if constexpr (std::is_same_v<T, float>)
+                unmultiply_alpha_hdr(src, dst, pixels, C::channels, C::alpha_index);
+            else
+                for (size_t i = 0; i < pixels; ++i)
+                    out[i] = in[i].unmultiply_alpha();
+        }
 
     }
 
+    class ResizeContext;
+
+    template <typename C, ImageFlags F> void resize_into(const Image<C, F>& in, Image<C, F>& out,
+        ResizeContext& context, ImageResize rflags = ImageResize::none, ResizeFilter filter = {});
+
+    class ResizeContext {
+    public:
+        ResizeContext() = default;
+        ~ResizeContext() noexcept = default;
+        ResizeContext(const ResizeContext&) = delete;
+        ResizeContext(ResizeContext&&) = default;
+        ResizeContext& operator=(const ResizeContext&) = delete;
+        ResizeContext& operator=(ResizeContext&&) = default;
+        size_t bytes() const noexcept;
+        void clear() noexcept { scratch_.clear(); filters_.clear(); }
+    private:
+        template <typename C, ImageFlags F> friend void resize_into(const Image<C, F>& in, Image<C, F>& out,
+            ResizeContext& context, ImageResize rflags, ResizeFilter filter);
+        Detail::ResizeScratchList scratch_;
+        Detail::ResampleCache filters_;
+    };
+
+    inline size_t ResizeContext::bytes() const noexcept {
+        size_t n = 0;
+        for (auto& s: scratch_)
+            n += s.bytes;
+        for (auto& f: filters_)
+            n += f->index.size() * sizeof(int) + f->weight.size() * sizeof(float);
+        return n;
+    }
+
     template <typename T, typename CS, Core::ColourLayout CL, ImageFlags Flags>
     class Image<Core::Colour<T, CS, CL>, Flags> {
 
@@ -103,23 +239,35 @@ namespace RS::Graphics::Plane {
         public:
 
             using difference_type = int64_t;
-            using iterator_category = std::bidirectional_iterator_tag;
+            using iterator_category = std::random_access_iterator_tag;
             using pointer = CC*;
             using reference = CC&;
-            using value_type = T;
+            using value_type = std::remove_const_t<CC>;
 
             basic_iterator() = default;
-            basic_iterator(const basic_iterator<std::remove_const_t<CI>, std::remove_const_t<CC>>& i):
+            template <typename CC2, typename = std::enable_if_t<std::is_same_v<const CC2, CC> && ! std::is_same_v<CC2, CC>>>
+                basic_iterator(const basic_iterator<std::remove_const_t<CI>, CC2>& i):
                 image_(i.image_), index_(i.index_) {}
 
             CC& operator*() const noexcept { return image_->pix_.get()[index_]; }
             CC* operator->() const noexcept { return &**this; }
+            CC& operator[](difference_type n) const noexcept { return image_->pix_.get()[index_ + n]; }
             basic_iterator& operator++() noexcept { ++index_; return *this; }
             basic_iterator operator++(int) noexcept { auto i = *this; ++*this; return i; }
             basic_iterator& operator--() noexcept { --index_; return *this; }
             basic_iterator operator--(int) noexcept { auto i = *this; --*this; return i; }
-            bool operator==(const basic_iterator& i) const noexcept { return index_ == i.index_; }
-            bool operator!=(const basic_iterator& i) const noexcept { return ! (*this == i); }
+            basic_iterator& operator+=(difference_type n) noexcept { index_ += n; return *this; }
+            basic_iterator& operator-=(difference_type n) noexcept { index_ -= n; return *this; }
+            friend basic_iterator operator+(basic_iterator i, difference_type n) noexcept { return i += n; }
+            friend basic_iterator operator+(difference_type n, basic_iterator i) noexcept { return i += n; }
+            friend basic_iterator operator-(basic_iterator i, difference_type n) noexcept { return i -= n; }
+            friend difference_type operator-(const basic_iterator& a, const basic_iterator& b) noexcept { return a.index_ - b.index_; }
+            friend bool operator==(const basic_iterator& a, const basic_iterator& b) noexcept { return a.index_ == b.index_; }
+            friend bool operator!=(const basic_iterator& a, const basic_iterator& b) noexcept { return ! (a == b); }
+            friend bool operator<(const basic_iterator& a, const basic_iterator& b) noexcept { return a.index_ < b.index_; }
+            friend bool operator>(const basic_iterator& a, const basic_iterator& b) noexcept { return b < a; }
+            friend bool operator<=(const basic_iterator& a, const basic_iterator& b) noexcept { return ! (b < a); }
+            friend bool operator>=(const basic_iterator& a, const basic_iterator& b) noexcept { return ! (a < b); }
 
             basic_iterator& move(int axis, int distance = 1) noexcept {
                 int64_t d = distance;
@@ -138,10 +286,10 @@ namespace RS::Graphics::Plane {
         private:
 
             friend class Image;
+            template <typename CI2, typename CC2> friend class basic_iterator;
 
-            CI* image_;
-            CC* data_;
-            int64_t index_;
+            CI* image_ = nullptr;
+            int64_t index_ = 0;
 
             basic_iterator(CI& image, int64_t index) noexcept:
                 image_(&image), index_(index) {}
@@ -202,7 +350,8 @@ namespace RS::Graphics::Plane {
         const_iterator top_right() const noexcept { return locate(width() - 1, is_top_down ? 0 : height() - 1); }
 
         void clear() noexcept { pix_.reset(); shape_ = {0, 0}; }
-        void fill(colour_type c) noexcept { std::fill(begin(), end(), c); }
+        void fill(colour_type c) noexcept { Detail::fill_pixels(pix_.get(), size(), c); }
+        void fill(const Core::Box_i2& box, colour_type c) noexcept;
 
         void load(const IO::Path& file);
         void save(const IO::Path& file, int quality = 90) const;
@@ -213,18 +362,22 @@ namespace RS::Graphics::Plane {
         const_iterator locate(int x, int y) const noexcept { return const_iterator(*this, make_index(x, y)); }
 
         template <typename U = T> Image<colour_type, Flags | ImageFlags::premultiplied>
-            multiply_alpha(std::enable_if<TL::SfinaeTrue<U, colour_type::can_premultiply && ! is_premultiplied>::value>* = nullptr) const;
+            multiply_alpha(std::enable_if<TL::SfinaeTrue<U, colour_type::can_premultiply && ! is_premultiplied>::value>* = nullptr) const &;
+        template <typename U = T> Image<colour_type, Flags | ImageFlags::premultiplied>
+            multiply_alpha(std::enable_if<TL::SfinaeTrue<U, colour_type::can_premultiply && ! is_premultiplied>::value>* = nullptr) &&;
+        template <typename U = T> Image<colour_type, Flags & ~ ImageFlags::premultiplied>
+            unmultiply_alpha(std::enable_if<TL::SfinaeTrue<U, colour_type::can_premultiply && is_premultiplied>::value>* = nullptr) const &;
         template <typename U = T> Image<colour_type, Flags & ~ ImageFlags::premultiplied>
-            unmultiply_alpha(std::enable_if<TL::SfinaeTrue<U, colour_type::can_premultiply && is_premultiplied>::value>* = nullptr) const;
+            unmultiply_alpha(std::enable_if<TL::SfinaeTrue<U, colour_type::can_premultiply && is_premultiplied>::value>* = nullptr) &&;
 
         void reset(Point new_shape);
         void reset(Point new_shape, colour_type c) { reset(new_shape); fill(c); }
         void reset(int w, int h) { reset(Point(w, h)); }
         void reset(int w, int h, colour_type c) { reset(Point(w, h), c); }
-        void resize(Point new_shape, ImageResize rflags = ImageResize::none);
-        void resize(double scale, ImageResize rflags = ImageResize::none);
-        Image resized(Point new_shape, ImageResize rflags = ImageResize::none) const;
-        Image resized(double scale, ImageResize rflags = ImageResize::none) const;
+        void resize(Point new_shape, ImageResize rflags = ImageResize::none, ResizeFilter filter = {});
+        void resize(double scale, ImageResize rflags = ImageResize::none, ResizeFilter filter = {});
+        Image resized(Point new_shape, ImageResize rflags = ImageResize::none, ResizeFilter filter = {}) const;
+        Image resized(double scale, ImageResize rflags = ImageResize::none, ResizeFilter filter = {}) const;
         Point shape() const noexcept { return shape_; }
         bool empty() const noexcept { return ! pix_; }
         int width() const noexcept { return shape_.x(); }
@@ -243,9 +396,20 @@ namespace RS::Graphics::Plane {
 
     private:
 
+        template <typename C, ImageFlags F> friend class Image;
+        template <typename C1, ImageFlags F1, typename C2, ImageFlags F2> friend void convert_image(Image<C1, F1>&& in, Image<C2, F2>& out);
+
         std::unique_ptr<colour_type, TL::FreeMem> pix_;
         Point shape_;
 
+        template <ImageFlags F> Image<colour_type, F> retype() noexcept {
+            Image<colour_type, F> img;
+            img.pix_ = std::move(pix_);
+            img.shape_ = shape_;
+            shape_ = {0, 0};
+            return img;
+        }
+
         int64_t make_index(int x, int y) const noexcept { return int64_t(width()) * y + x; }
 
     };
@@ -260,6 +424,11 @@ namespace RS::Graphics::Plane {
     using PmaImage16 = Image<Core::Rgba16, ImageFlags::premultiplied>;
     using PmaHdrImage = Image<Core::Rgbaf, ImageFlags::premultiplied>;
 
+    // Conversion is done one row at a time: unmultiply (into a row buffer
+    // if the colour type changes), convert each pixel straight into the
+    // output row, then premultiply the output row in place. The output
+    // image's buffer is reused if it already has the right shape.
+
     template <typename C1, ImageFlags F1, typename C2, ImageFlags F2>
     void convert_image(const Image<C1, F1>& in, Image<C2, F2>& out) {
 
@@ -270,44 +439,106 @@ namespace RS::Graphics::Plane {
 
             out = in;
 
-        } else if constexpr (Img1::is_premultiplied) {
+        } else {
 
-            auto linear_in = in.unmultiply_alpha();
-            convert_image(linear_in, out);
+            if (out.shape() != in.shape())
+                out.reset(in.shape());
+            if (in.empty())
+                return;
 
-        } else if constexpr (Img2::is_premultiplied) {
+            bool flip = Img1::is_top_down != Img2::is_top_down;
+            int w = in.width();
+            int h = in.height();
+            std::vector<C1> buffer;
 
-            Image<C2, F2 & ~ ImageFlags::premultiplied> linear_out;
-            convert_image(in, linear_out);
-            out = linear_out.multiply_alpha();
+            if constexpr (Img1::is_premultiplied && ! std::is_same_v<C1, C2>)
+                buffer.resize(size_t(w));
 
-        } else {
+            for (int y = 0; y < h; ++y) {
 
-            Img2 result(in.shape());
-            int dy, y1, y2;
-            if (Img1::is_top_down == Img2::is_top_down) {
-                dy = 1;
-                y1 = 0;
-                y2 = in.height();
-            } else {
-                dy = -1;
-                y1 = in.height() - 1;
-                y2 = -1;
-            }
+                auto src = &in(0, y);
+                auto dst = &out(0, flip ? h - 1 - y : y);
+
+                if constexpr (std::is_same_v<C1, C2>) {
+
+                    if constexpr (Img1::is_premultiplied == Img2::is_premultiplied)
+                        std::memcpy(dst, src, size_t(w) * sizeof(C1));
+                    else if constexpr (Img1::is_premultiplied)
+                        Detail::unmultiply_alpha_pixels(src, dst, size_t(w));
+                    else
+                        Detail::multiply_alpha_pixels(src, dst, size_t(w));
+
+                } else {
+
+                    if constexpr (Img1::is_premultiplied) {
+                        Detail::unmultiply_alpha_pixels(src, buffer.data(), size_t(w));
+                        src = buffer.data();
+                    }
+
+                    for (int x = 0; x < w; ++x)
+                        convert_colour(src[x], dst[x]);
+
+                    if constexpr (Img2::is_premultiplied)
+                        Detail::multiply_alpha_pixels(dst, dst, size_t(w));
+
+                }
 
-            for (int y = y1; y != y2; y += dy) {
-                auto i = in.locate(0, y);
-                auto j = result.locate(0, y);
-                for (int x = 0; x < in.width(); ++x, ++i, ++j)
-                    convert_colour(*i, *j);
             }
 
-            out = std::move(result);
+        }
+
+    }
+
+    // If the colour type is unchanged, an rvalue image is converted in place
+    // and its buffer moved into the output image. Flipping only swaps rows.
+
+    template <typename C1, ImageFlags F1, typename C2, ImageFlags F2>
+    void convert_image(Image<C1, F1>&& in, Image<C2, F2>& out) {
+
+        using Img1 = Image<C1, F1>;
+        using Img2 = Image<C2, F2>;
+
+        if constexpr (std::is_same_v<Img1, Img2>) {
+
+            out = std::move(in);
+
+        } else if constexpr (std::is_same_v<C1, C2>) {
+
+            if constexpr (Img1::is_premultiplied && ! Img2::is_premultiplied)
+                Detail::unmultiply_alpha_pixels(in.pix_.get(), in.pix_.get(), in.size());
+            else if constexpr (Img2::is_premultiplied && ! Img1::is_premultiplied)
+                Detail::multiply_alpha_pixels(in.pix_.get(), in.pix_.get(), in.size());
+
+            if constexpr (Img1::is_top_down != Img2::is_top_down)
+                Detail::flip_rows(in.pix_.get(), in.height(), size_t(in.width()) * sizeof(C1));
+
+            out = in.template retype<F2>();
+
+        } else {
+
+            convert_image(static_cast<const Img1&>(in), out);
+            in.clear();
 
         }
 
     }
 
+    template <typename T, typename CS, Core::ColourLayout CL, ImageFlags Flags>
+    void Image<Core::Colour<T, CS, CL>, Flags>::fill(const Core::Box_i2& box, colour_type c) noexcept {
+        int x1 = std::max(0, box.base().x());
+        int y1 = std::max(0, box.base().y());
+        int x2 = std::min(width(), box.apex().x());
+        int y2 = std::min(height(), box.apex().y());
+        if (x1 >= x2 || y1 >= y2)
+            return;
+        if (x1 == 0 && x2 == width()) {
+            Detail::fill_pixels(&(*this)(0, y1), size_t(width()) * size_t(y2 - y1), c);
+        } else {
+            for (int y = y1; y < y2; ++y)
+                Detail::fill_pixels(&(*this)(x1, y), size_t(x2 - x1), c);
+        }
+    }
+
     template <typename T, typename CS, Core::ColourLayout CL, ImageFlags Flags>
     void Image<Core::Colour<T, CS, CL>, Flags>::load(const IO::Path& file) {
         Point shape;
@@ -315,17 +546,17 @@ namespace RS::Graphics::Plane {
             auto image_ptr = Detail::load_image_8(file, shape);
             Image<Core::Rgba8> image(shape);
             std::memcpy(image.data(), image_ptr.get(), image.bytes());
-            convert_image(image, *this);
+            convert_image(std::move(image), *this);
         } else if constexpr (std::is_same_v<channel_type, uint16_t>) {
             auto image_ptr = Detail::load_image_16(file, shape);
             Image<Core::Rgba16> image(shape);
             std::memcpy(image.data(), image_ptr.get(), image.bytes());
-            convert_image(image, *this);
+            convert_image(std::move(image), *this);
         } else {
             auto image_ptr = Detail::load_image_hdr(file, shape);
             Image<Core::Rgbaf> image(shape);
             std::memcpy(image.data(), image_ptr.get(), image.bytes());
-            convert_image(image, *this);
+            convert_image(std::move(image), *this);
         }
     }
 
@@ -347,26 +578,40 @@ namespace RS::Graphics::Plane {
     template <typename U>
     Image<Core::Colour<T, CS, CL>, Flags | ImageFlags::premultiplied>
     Image<Core::Colour<T, CS, CL>, Flags>::multiply_alpha(std::enable_if<TL::SfinaeTrue<U, colour_type::can_premultiply
-            && ! is_premultiplied>::value>*) const {
+            && ! is_premultiplied>::value>*) const & {
         Image<colour_type, Flags | ImageFlags::premultiplied> result(shape());
-        auto out = result.begin();
-        for (auto& pixel: *this)
-            *out++ = pixel.multiply_alpha();
+        Detail::multiply_alpha_pixels(pix_.get(), result.pix_.get(), size());
         return result;
     }
 
+    template <typename T, typename CS, Core::ColourLayout CL, ImageFlags Flags>
+    template <typename U>
+    Image<Core::Colour<T, CS, CL>, Flags | ImageFlags::premultiplied>
+    Image<Core::Colour<T, CS, CL>, Flags>::multiply_alpha(std::enable_if<TL::SfinaeTrue<U, colour_type::can_premultiply
+            && ! is_premultiplied>::value>*) && {
+        Detail::multiply_alpha_pixels(pix_.get(), pix_.get(), size());
+        return retype<Flags | ImageFlags::premultiplied>();
+    }
+
     template <typename T, typename CS, Core::ColourLayout CL, ImageFlags Flags>
     template <typename U>
     Image<Core::Colour<T, CS, CL>, Flags & ~ ImageFlags::premultiplied>
     Image<Core::Colour<T, CS, CL>, Flags>::unmultiply_alpha(std::enable_if<TL::SfinaeTrue<U, colour_type::can_premultiply
-            && is_premultiplied>::value>*) const {
+            && is_premultiplied>::value>*) const & {
         Image<colour_type, Flags & ~ ImageFlags::premultiplied> result(shape());
-        auto out = result.begin();
-        for (auto& pixel: *this)
-            *out++ = pixel.unmultiply_alpha();
+        Detail::unmultiply_alpha_pixels(pix_.get(), result.pix_.get(), size());
         return result;
     }
 
+    template <typename T, typename CS, Core::ColourLayout CL, ImageFlags Flags>
+    template <typename U>
+    Image<Core::Colour<T, CS, CL>, Flags & ~ ImageFlags::premultiplied>
+    Image<Core::Colour<T, CS, CL>, Flags>::unmultiply_alpha(std::enable_if<TL::SfinaeTrue<U, colour_type::can_premultiply
+            && is_premultiplied>::value>*) && {
+        Detail::unmultiply_alpha_pixels(pix_.get(), pix_.get(), size());
+        return retype<Flags & ~ ImageFlags::premultiplied>();
+    }
+
     template <typename T, typename CS, Core::ColourLayout CL, ImageFlags Flags>
     void Image<Core::Colour<T, CS, CL>, Flags>::reset(Point new_shape) {
         if (new_shape == Point(0, 0)) {
@@ -384,35 +629,22 @@ namespace RS::Graphics::Plane {
     }
 
     template <typename T, typename CS, Core::ColourLayout CL, ImageFlags Flags>
-    void Image<Core::Colour<T, CS, CL>, Flags>::resize(Point new_shape, ImageResize rflags) {
-        auto img = resized(new_shape, rflags);
+    void Image<Core::Colour<T, CS, CL>, Flags>::resize(Point new_shape, ImageResize rflags, ResizeFilter filter) {
+        auto img = resized(new_shape, rflags, filter);
         *this = std::move(img);
     }
 
     template <typename T, typename CS, Core::ColourLayout CL, ImageFlags Flags>
-    void Image<Core::Colour<T, CS, CL>, Flags>::resize(double scale, ImageResize rflags) {
-        auto img = resized(scale, rflags);
+    void Image<Core::Colour<T, CS, CL>, Flags>::resize(double scale, ImageResize rflags, ResizeFilter filter) {
+        auto img = resized(scale, rflags, filter);
         *this = std::move(img);
     }
 
     template <typename T, typename CS, Core::ColourLayout CL, ImageFlags Flags>
     Image<Core::Colour<T, CS, CL>, Flags>
-    Image<Core::Colour<T, CS, CL>, Flags>::resized(Point new_shape, ImageResize rflags) const {
-
-        static constexpr int stbir_flag_alpha_premultiplied  = 1;
-        static constexpr int stbir_edge_clamp                = 1;
-        static constexpr int stbir_edge_wrap                 = 3;
-        static constexpr int stbir_filter_default            = 0;
-        static constexpr int stbir_colorspace_linear         = 0;
-        static constexpr int stbir_colorspace_srgb           = 1;
-
-        using working_channel = std::conditional_t<std::is_same_v<T, uint8_t> || std::is_same_v<T, uint16_t>, T, float>;
-        using working_space = std::conditional_t<std::is_same_v<CS, Core::sRGB>, Core::sRGB, Core::LinearRGB>;
-        using working_colour = Core::Colour<working_channel, working_space, CL>;
-        using working_image = Image<working_colour, Flags>;
+    Image<Core::Colour<T, CS, CL>, Flags>::resized(Point new_shape, ImageResize rflags, ResizeFilter filter) const {
 
         bool use_unlock = !! (rflags & ImageResize::unlock);
-        bool use_wrap = !! (rflags & ImageResize::wrap);
 
         auto fail = [new_shape] {
             throw std::invalid_argument(Format::format("Invalid image dimensions: {0}", new_shape));
@@ -446,27 +678,9 @@ namespace RS::Graphics::Plane {
 
         }
 
-        int stb_flags = is_premultiplied ? stbir_flag_alpha_premultiplied : 0;
-        int stb_edge = use_wrap ? stbir_edge_wrap : stbir_edge_clamp;
-        int stb_filter = stbir_filter_default;
-        int stb_space = std::is_same_v<CS, Core::sRGB> ? stbir_colorspace_srgb : stbir_colorspace_linear;
-
-        working_image working_input;
-        convert_image(*this, working_input);
-        working_image working_output(actual_shape);
-
-        if constexpr (std::is_same_v<channel_type, uint8_t>)
-            Detail::resize_image_8(working_input.data(), shape_, working_output.data(), actual_shape,
-                working_colour::channels, working_colour::alpha_index, stb_flags, stb_edge, stb_filter, stb_space);
-        else if constexpr (std::is_same_v<channel_type, uint16_t>)
-            Detail::resize_image_16(working_input.data(), shape_, working_output.data(), actual_shape,
-                working_colour::channels, working_colour::alpha_index, stb_flags, stb_edge, stb_filter, stb_space);
-        else
-            Detail::resize_image_hdr(working_input.data(), shape_, working_output.data(), actual_shape,
-                working_colour::channels, working_colour::alpha_index, stb_flags, stb_edge, stb_filter, stb_space);
-
-        Image result;
-        convert_image(working_output, result);
+        Image result(actual_shape);
+        ResizeContext context;
+        resize_into(*this, result, context, rflags, filter);
 
         return result;
 
@@ -474,12 +688,111 @@ namespace RS::Graphics::Plane {
 
     template <typename T, typename CS, Core::ColourLayout CL, ImageFlags Flags>
     Image<Core::Colour<T, CS, CL>, Flags>
-    Image<Core::Colour<T, CS, CL>, Flags>::resized(double scale, ImageResize rflags) const {
+    Image<Core::Colour<T, CS, CL>, Flags>::resized(double scale, ImageResize rflags, ResizeFilter filter) const {
         if (scale <= 0)
             throw std::invalid_argument(Format::format("Invalid image scale factor: {0}", scale));
         int w = int(std::lround(scale * width()));
         int h = int(std::lround(scale * height()));
-        return resized(Point{w, h}, rflags | ImageResize::unlock);
+        return resized(Point{w, h}, rflags | ImageResize::unlock, filter);
+    }
+
+    template <typename C, ImageFlags F>
+    void resize_into(const Image<C, F>& in, Image<C, F>& out, ResizeContext& context, ImageResize rflags, ResizeFilter filter) {
+
+        static constexpr int stbir_flag_alpha_premultiplied  = 1;
+        static constexpr int stbir_edge_clamp                = 1;
+        static constexpr int stbir_edge_wrap                 = 3;
+        static constexpr int stbir_colorspace_linear         = 0;
+        static constexpr int stbir_colorspace_srgb           = 1;
+
+        using image_type = Image<C, F>;
+        using channel_type = typename image_type::channel_type;
+        using colour_space = typename image_type::colour_space;
+        using working_channel = std::conditional_t<std::is_same_v<channel_type, uint8_t>
+            || std::is_same_v<channel_type, uint16_t>, channel_type, float>;
+        using working_space = std::conditional_t<std::is_same_v<colour_space, Core::sRGB>, Core::sRGB, Core::LinearRGB>;
+        using working_colour = Core::Colour<working_channel, working_space, image_type::colour_layout>;
+        using working_image = Image<working_colour, F>;
+        using resample_colour = Core::Colour<float, Core::LinearRGB, image_type::colour_layout>;
+        using resample_image = Image<resample_colour, image_type::has_alpha ? F | ImageFlags::premultiplied : F>;
+
+        if (in.empty() || out.empty())
+            throw std::invalid_argument(Format::format("Invalid image dimensions: {0} => {1}", in.shape(), out.shape()));
+
+        bool use_wrap = !! (rflags & ImageResize::wrap);
+        bool use_parallel = !! (rflags & ImageResize::parallel);
+        auto h_filter = filter.select(in.width(), out.width());
+        auto v_filter = filter.select(in.height(), out.height());
+
+        // Lanczos filtering isn't available in stb_image_resize, so it goes
+        // through our own resampler, in premultiplied linear light
+
+        if (h_filter == ImageFilter::lanczos3 || v_filter == ImageFilter::lanczos3) {
+
+            auto resolve = [] (ImageFilter f, int in_size, int out_size) {
+                if (f == ImageFilter::automatic)
+                    f = out_size > in_size ? ImageFilter::catmull_rom : ImageFilter::mitchell;
+                return int(f);
+            };
+
+            resample_image working_input;
+            convert_image(in, working_input);
+            resample_image working_output(out.shape());
+            Detail::resample_image(working_input.data(), in.shape(), working_output.data(), out.shape(),
+                resample_colour::channels, resample_colour::alpha_index,
+                resolve(h_filter, in.width(), out.width()), resolve(v_filter, in.height(), out.height()),
+                use_wrap, use_parallel, context.filters_);
+            convert_image(working_output, out);
+            return;
+
+        }
+
+        int stb_flags = image_type::is_premultiplied ? stbir_flag_alpha_premultiplied : 0;
+        int stb_edge = use_wrap ? stbir_edge_wrap : stbir_edge_clamp;
+        int stb_space = std::is_same_v<colour_space, Core::sRGB> ? stbir_colorspace_srgb : stbir_colorspace_linear;
+
+        // Exact integer reductions are a plain block average, which is what
+        // the box filter gives for these ratios anyway
+
+        bool reduce = in.width() % out.width() == 0 && in.height() % out.height() == 0
+            && (filter.down == ImageFilter::automatic || filter.down == ImageFilter::box);
+        bool is_srgb = std::is_same_v<colour_space, Core::sRGB>;
+
+        auto resize_working = [&] (const working_image& win, working_image& wout) {
+            if (reduce) {
+                if constexpr (std::is_same_v<working_channel, uint8_t>)
+                    Detail::reduce_image_8(win.data(), win.shape(), wout.data(), wout.shape(), working_colour::channels,
+                        working_colour::alpha_index, image_type::is_premultiplied, is_srgb, use_parallel);
+                else if constexpr (std::is_same_v<working_channel, uint16_t>)
+                    Detail::reduce_image_16(win.data(), win.shape(), wout.data(), wout.shape(), working_colour::channels,
+                        working_colour::alpha_index, image_type::is_premultiplied, is_srgb, use_parallel);
+                else
+                    Detail::reduce_image_hdr(win.data(), win.shape(), wout.data(), wout.shape(), working_colour::channels,
+                        working_colour::alpha_index, image_type::is_premultiplied, is_srgb, use_parallel);
+            } else if constexpr (std::is_same_v<working_channel, uint8_t>)
+                Detail::resize_image_8(win.data(), win.shape(), wout.data(), wout.shape(), working_colour::channels,
+                    working_colour::alpha_index, stb_flags, stb_edge, int(h_filter), int(v_filter), stb_space,
+                    use_parallel, context.scratch_);
+            else if constexpr (std::is_same_v<working_channel, uint16_t>)
+                Detail::resize_image_16(win.data(), win.shape(), wout.data(), wout.shape(), working_colour::channels,
+                    working_colour::alpha_index, stb_flags, stb_edge, int(h_filter), int(v_filter), stb_space,
+                    use_parallel, context.scratch_);
+            else
+                Detail::resize_image_hdr(win.data(), win.shape(), wout.data(), wout.shape(), working_colour::channels,
+                    working_colour::alpha_index, stb_flags, stb_edge, int(h_filter), int(v_filter), stb_space,
+                    use_parallel, context.scratch_);
+        };
+
+        if constexpr (std::is_same_v<working_image, image_type>) {
+            resize_working(in, out);
+        } else {
+            working_image working_input;
+            convert_image(in, working_input);
+            working_image working_output(out.shape());
+            resize_working(working_input, working_output);
+            convert_image(working_output, out);
+        }
+
     }
 
 }
@@ -0,0 +1,99 @@
+#include "rs-graphics-2d/label-index.hpp"
+#include <stdexcept>
+
+using namespace RS::Graphics::Core;
+
+namespace RS::Graphics::Plane {
+
+    namespace {
+
+        bool is_empty_box(const Box_i2& box) noexcept {
+            return box.shape().x() <= 0 || box.shape().y() <= 0;
+        }
+
+        bool boxes_overlap(const Box_i2& a, const Box_i2& b) noexcept {
+            return a.base().x() < b.apex().x() && b.base().x() < a.apex().x()
+                && a.base().y() < b.apex().y() && b.base().y() < a.apex().y();
+        }
+
+        int floor_div(int x, int y) noexcept {
+            return x >= 0 ? x / y : - ((- x - 1) / y) - 1;
+        }
+
+        uint64_t cell_key(int x, int y) noexcept {
+            return (uint64_t(uint32_t(x)) << 32) | uint64_t(uint32_t(y));
+        }
+
+    }
+
+    LabelIndex::LabelIndex(int cell_size):
+    cell_size_(cell_size) {
+        if (cell_size <= 0)
+            throw std::invalid_argument("Invalid label index cell size");
+    }
+
+    // Calls f(key) for each grid cell overlapped by the box, stopping early
+    // if f() returns false
+
+    template <typename F>
+    void LabelIndex::for_each_cell(const Box_i2& box, F f) const {
+        int x1 = floor_div(box.base().x(), cell_size_);
+        int y1 = floor_div(box.base().y(), cell_size_);
+        int x2 = floor_div(box.apex().x() - 1, cell_size_);
+        int y2 = floor_div(box.apex().y() - 1, cell_size_);
+        for (int y = y1; y <= y2; ++y)
+            for (int x = x1; x <= x2; ++x)
+                if (! f(cell_key(x, y)))
+                    return;
+    }
+
+    void LabelIndex::clear() noexcept {
+        boxes_.clear();
+        cells_.clear();
+    }
+
+    bool LabelIndex::collides(const Box_i2& box) const {
+        if (is_empty_box(box))
+            return false;
+        bool found = false;
+        for_each_cell(box, [&] (uint64_t key) {
+            auto it = cells_.find(key);
+            if (it != cells_.end())
+                for (auto index: it->second)
+                    if (boxes_overlap(box, boxes_[index]))
+                        found = true;
+            return ! found;
+        });
+        return found;
+    }
+
+    void LabelIndex::add(const Box_i2& box) {
+        if (is_empty_box(box))
+            return;
+        auto index = uint32_t(boxes_.size());
+        boxes_.push_back(box);
+        for_each_cell(box, [&] (uint64_t key) {
+            cells_[key].push_back(index);
+            return true;
+        });
+    }
+
+    bool LabelIndex::insert(const Box_i2& box) {
+        if (collides(box))
+            return false;
+        add(box);
+        return true;
+    }
+
+    bool LabelIndex::insert_text(const ScaledFont& font, Point ref_point, const std::string& text, int line_shift, int margin) {
+        if (! font)
+            throw std::invalid_argument("No font");
+        auto box = font.text_box(text, line_shift);
+        if (is_empty_box(box))
+            return true;
+        Point base = ref_point + box.base() - Point{margin, margin};
+        Point shape = box.shape() + Point{2 * margin, 2 * margin};
+        return insert(Box_i2(base, shape));
+    }
+
+}
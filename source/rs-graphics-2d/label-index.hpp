@@ -0,0 +1,42 @@
+#pragma once
+
+#include "rs-graphics-2d/font.hpp"
+#include "rs-graphics-core/geometry.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace RS::Graphics::Plane {
+
+    class LabelIndex {
+
+    public:
+
+        static constexpr int default_cell_size = 64;
+
+        LabelIndex() = default;
+        explicit LabelIndex(int cell_size);
+
+        int cell_size() const noexcept { return cell_size_; }
+        void clear() noexcept;
+        bool empty() const noexcept { return boxes_.empty(); }
+        size_t size() const noexcept { return boxes_.size(); }
+        const std::vector<Core::Box_i2>& boxes() const noexcept { return boxes_; }
+
+        bool collides(const Core::Box_i2& box) const;
+        void add(const Core::Box_i2& box);
+        bool insert(const Core::Box_i2& box);
+        bool insert_text(const ScaledFont& font, Point ref_point, const std::string& text, int line_shift = 0, int margin = 0);
+
+    private:
+
+        int cell_size_ = default_cell_size;
+        std::vector<Core::Box_i2> boxes_;
+        std::unordered_map<uint64_t, std::vector<uint32_t>> cells_; // Indices into boxes_
+
+        template <typename F> void for_each_cell(const Core::Box_i2& box, F f) const;
+
+    };
+
+}
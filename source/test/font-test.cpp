@@ -3,12 +3,23 @@
 #include "rs-graphics-core/colour.hpp"
 #include "rs-graphics-core/geometry.hpp"
 #include "rs-graphics-core/vector.hpp"
+#include "rs-io/path.hpp"
 #include "rs-unit-test.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
 #include <string>
 #include <vector>
 
 using namespace RS::Graphics::Core;
 using namespace RS::Graphics::Plane;
+using namespace RS::IO;
 
 namespace {
 
@@ -17,6 +28,68 @@ namespace {
     const std::string serif_file = fonts_dir + "DejaVuSerif.ttf";
     const std::string ttc_file = fonts_dir + "DejaVu2.ttc";
     const std::string no_such_file = fonts_dir + "NoSuchFile.ttf";
+    const std::string not_font_file = fonts_dir + "license.txt";
+
+    class FontProbe:
+    public Font {
+    public:
+        explicit FontProbe(const Font& font): Font(font) {}
+        const void* content() const noexcept { return content_.get(); }
+    };
+
+    void copy_file(const std::string& from, const std::string& to) {
+        std::ifstream in(from, std::ios::binary);
+        std::ofstream out(to, std::ios::binary);
+        out << in.rdbuf();
+    }
+
+    std::string read_file(const std::string& file) {
+        std::ifstream in(file, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    void write_file(const std::string& file, const std::string& content) {
+        std::ofstream out(file, std::ios::binary | std::ios::trunc);
+        out.write(content.data(), std::streamsize(content.size()));
+    }
+
+    uint32_t get_be32(const std::string& data, size_t pos) {
+        uint32_t n = 0;
+        for (size_t i = 0; i < 4; ++i)
+            n = (n << 8) | uint8_t(data[pos + i]);
+        return n;
+    }
+
+    // Offset of a table's directory record, given the offset of the face's
+    // table directory, or zero if the table is not found
+
+    size_t find_table_record(const std::string& data, size_t face_offset, const std::string& tag) {
+        size_t num_tables = get_be32(data, face_offset + 4) >> 16;
+        for (size_t i = 0; i < num_tables; ++i) {
+            size_t record = face_offset + 12 + 16 * i;
+            if (data.compare(record, 4, tag) == 0)
+                return record;
+        }
+        return 0;
+    }
+
+    // Copy a font file with the group count of every format 12 cmap
+    // subtable set far beyond the end of the file
+
+    void write_bad_cmap_font(const std::string& from, const std::string& to) {
+        std::string content = read_file(from);
+        size_t record = find_table_record(content, 0, "cmap");
+        if (record == 0)
+            return;
+        size_t cmap = get_be32(content, record + 8);
+        size_t num_subtables = get_be32(content, cmap) & 0xffff;
+        for (size_t i = 0; i < num_subtables; ++i) {
+            size_t subtable = cmap + get_be32(content, cmap + 8 + 8 * i);
+            if (get_be32(content, subtable) >> 16 == 12)
+                content.replace(subtable + 12, 4, "\x0f\xff\xff\xff");
+        }
+        write_file(to, content);
+    }
 
 }
 
@@ -40,6 +113,51 @@ void test_rs_graphics_2d_font_loading() {
 
     TRY(font = Font(no_such_file));
     TEST(! font);
+    TRY(font = Font(not_font_file));
+    TEST(! font);
+    TRY(fonts = Font::load(not_font_file));
+    TEST(fonts.empty());
+
+}
+
+void test_rs_graphics_2d_font_file_sharing() {
+
+    const std::string temp_file = "font-sharing.tmp";
+    const std::string temp_file_2 = "font-sharing-2.tmp";
+
+    Font font1, font2;
+    std::vector<Font> fonts;
+
+    TRY(font1 = Font(serif_file));
+    TRY(font2 = Font(serif_file));
+    TEST(font1);
+    TEST(font2);
+    TEST(FontProbe(font1).content() != nullptr);
+    TEST_EQUAL(FontProbe(font1).content(), FontProbe(font2).content());
+
+    TRY(fonts = Font::load(ttc_file));
+    TEST_EQUAL(fonts.size(), 2u);
+    TEST_EQUAL(FontProbe(fonts[0]).content(), FontProbe(fonts[1]).content());
+    TEST(FontProbe(fonts[0]).content() != FontProbe(font1).content());
+
+    // Replacing the file should produce a new mapping, while fonts already
+    // loaded keep the old one
+
+    std::remove(temp_file.data());
+    copy_file(mono_file, temp_file);
+    TRY(font1 = Font(temp_file));
+    TEST_EQUAL(font1.name(), "DejaVu Sans Mono");
+
+    copy_file(serif_file, temp_file_2);
+    std::remove(temp_file.data());
+    TEST_EQUAL(std::rename(temp_file_2.data(), temp_file.data()), 0);
+    TRY(font2 = Font(temp_file));
+    TEST_EQUAL(font2.name(), "DejaVu Serif");
+    TEST(FontProbe(font2).content() != FontProbe(font1).content());
+    TEST_EQUAL(font1.name(), "DejaVu Sans Mono");
+    TEST(font1.has_glyph(U'A'));
+
+    std::remove(temp_file.data());
 
 }
 
@@ -95,6 +213,57 @@ void test_rs_graphics_2d_font_properties() {
 
 }
 
+void test_rs_graphics_2d_font_coverage() {
+
+    Font mono, serif;
+    FontMap map;
+    std::vector<std::string> families;
+
+    TRY(mono = Font(mono_file));
+    TRY(serif = Font(serif_file));
+
+    TEST(mono.has_glyph(U'~'));
+    TEST(mono.has_glyph(0x3a9)); // Greek capital omega
+    TEST(mono.has_glyph(0x20a0)); // Euro-currency sign
+    TEST(! mono.has_glyph(0x4e00)); // CJK unified ideograph
+    TEST(! mono.has_glyph(0xd800)); // Surrogate
+    TEST(! mono.has_glyph(0x10ffff));
+    TEST(! mono.has_glyph(0x110000));
+    TEST(mono.has_glyphs(0x391, 0x3a1));
+    TEST(! mono.has_glyphs(0x4e00, 0x4eff));
+
+    TEST(serif.has_glyph(0x3a9));
+    TEST(! serif.has_glyph(0x20a0));
+    TEST(! serif.has_glyph(0x4e00));
+
+    TRY(map.search(fonts_dir));
+    TRY(families = map.families_covering("Hello"));
+    TEST_EQUAL(families.size(), 2u);
+    TRY(families = map.families_covering("\u20a0"));
+    TEST(std::find(families.begin(), families.end(), "DejaVu Sans Mono") != families.end());
+    TEST(std::find(families.begin(), families.end(), "DejaVu Serif") == families.end());
+    TRY(families = map.families_covering("Hello \u4e00"));
+    TEST(families.empty());
+
+}
+
+void test_rs_graphics_2d_font_coverage_bad_cmap() {
+
+    const std::string temp_file = "font-coverage.tmp";
+
+    Font font;
+
+    TRY(write_bad_cmap_font(mono_file, temp_file));
+    TRY(font = Font(temp_file));
+    TEST(font);
+    TEST(! font.has_glyph(U'A'));
+    TEST(! font.has_glyph(0x3a9));
+    TEST(! font.has_glyphs(U'A', U'Z'));
+
+    std::remove(temp_file.data());
+
+}
+
 void test_rs_graphics_2d_font_metrics() {
 
     Font mono, serif;
@@ -354,6 +523,212 @@ void test_rs_graphics_2d_font_rendering() {
 
 }
 
+void test_rs_graphics_2d_font_blending() {
+
+    static const std::string text = "Hello world";
+    static const Rgba8 background(200, 100, 50, 128);
+    static const Rgba8 foreground(0, 80, 160, 192);
+
+    Font serif;
+    ScaledFont s_serif;
+    Image8 image({150, 40}, background);
+    PmaImage8 pma_image({150, 40}, background.multiply_alpha());
+    Image8 unmultiplied;
+    int max_diff = 0;
+    int n_changed = 0;
+
+    TRY(serif = Font(serif_file));
+    TRY(s_serif = ScaledFont(serif, 24));
+    TRY(s_serif.render_to(image, {5, 30}, text, 0, foreground));
+    TRY(s_serif.render_to(pma_image, {5, 30}, text, 0, foreground));
+    TRY(unmultiplied = pma_image.unmultiply_alpha());
+
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x) {
+            auto& a = image(x, y);
+            auto& b = unmultiplied(x, y);
+            if (a != background)
+                ++n_changed;
+            for (int c = 0; c < 4; ++c)
+                max_diff = std::max(max_diff, std::abs(int(a[c]) - int(b[c])));
+        }
+    }
+
+    TEST(n_changed > 100);
+    TEST(max_diff <= 2);
+
+    TRY(image.fill(background));
+    TRY(s_serif.render_to(image, {5, 30}, text, 0, Rgba8::red()));
+    n_changed = 0;
+    for (auto& pixel: image)
+        if (pixel == Rgba8::red())
+            ++n_changed;
+    TEST(n_changed > 50);
+
+    // Two lines drawn on top of each other should look the same as one line
+
+    Image8 overlaid({150, 40}, background);
+    TRY(image.fill(background));
+    TRY(s_serif.render_to(image, {5, 30}, text, 0, foreground));
+    TRY(s_serif.render_to(overlaid, {5, 30}, text + "\n" + text, - s_serif.line_offset(), foreground));
+    TEST(overlaid == image);
+
+}
+
+void test_rs_graphics_2d_font_subpixel_rendering() {
+
+    static const std::string text = "Hello world\nGoodbye";
+
+    Font mono;
+    ScaledFont s_mono, s_mono_sub;
+    HdrImage image;
+    Point offset;
+    Box_i2 box;
+
+    TRY(mono = Font(mono_file));
+    TRY(s_mono = ScaledFont(mono, 11));
+    TRY(s_mono_sub = ScaledFont(mono, 11, FontRender::subpixel));
+    TEST_EQUAL(s_mono_sub.ascent(), s_mono.ascent());
+    TEST_EQUAL(s_mono_sub.descent(), s_mono.descent());
+
+    TRY(box = s_mono.text_box(text, 0));
+    TEST_EQUAL(box, Box_i2({0,-9}, {76, 25}));
+    TRY(box = s_mono_sub.text_box(text, 0));
+    TEST_EQUAL(box, Box_i2({0,-9}, {72, 25}));
+
+    TRY(s_mono_sub.render(image, offset, text, 0, Rgbaf::blue()));
+    TEST_EQUAL(offset, box.base());
+    TEST_EQUAL(image.shape(), box.shape());
+
+}
+
+void test_rs_graphics_2d_font_sdf_rendering() {
+
+    static const std::string text = "Hello world\nGoodbye";
+
+    Font serif;
+    ScaledFont s_serif;
+    HdrImage image;
+    Point offset;
+    double ink1 = 0, ink2 = 0;
+
+    TRY(serif = Font(serif_file));
+
+    for (int scale: {20, 100}) {
+
+        TRY(s_serif = ScaledFont(serif, scale));
+        TRY(s_serif.render(image, offset, text, 0, Rgbaf::blue()));
+        ink1 = 0;
+        for (auto& pixel: image)
+            ink1 += pixel.alpha();
+
+        TRY(s_serif = ScaledFont(serif, scale, FontRender::sdf));
+        TRY(s_serif.render(image, offset, text, 0, Rgbaf::blue()));
+        TEST_EQUAL(image.shape(), s_serif.text_box(text).shape());
+        ink2 = 0;
+        for (auto& pixel: image)
+            ink2 += pixel.alpha();
+
+        TEST_NEAR(ink2 / ink1, 1, 0.05);
+
+    }
+
+}
+
+void test_rs_graphics_2d_font_fallback() {
+
+    static const std::string euro_currency = "\u20a0";
+
+    Font mono, serif;
+    ScaledFont s_mono, s_serif, chain;
+    FontMap map;
+    std::vector<Font> fonts;
+    HdrImage image1, image2;
+    Point offset1, offset2;
+
+    TRY(mono = Font(mono_file));
+    TRY(serif = Font(serif_file));
+    TEST(! serif.has_glyph(0x20a0));
+    TRY(s_mono = ScaledFont(mono, 20));
+    TRY(s_serif = ScaledFont(serif, 20));
+    TRY(chain = ScaledFont({serif, mono}, 20));
+
+    TEST(chain);
+    TEST_EQUAL(chain.family(), "DejaVu Serif");
+    TEST_EQUAL(chain.ascent(), s_serif.ascent());
+    TEST_EQUAL(chain.descent(), s_serif.descent());
+    TEST_EQUAL(chain.line_gap(), s_serif.line_gap());
+
+    TEST_EQUAL(chain.text_box("Hello"), s_serif.text_box("Hello"));
+    TEST_EQUAL(chain.text_box(euro_currency), s_mono.text_box(euro_currency));
+    TEST(chain.text_box(euro_currency) != s_serif.text_box(euro_currency));
+
+    TRY(chain.render(image1, offset1, euro_currency));
+    TRY(s_mono.render(image2, offset2, euro_currency));
+    TEST_EQUAL(offset1, offset2);
+    TEST(image1 == image2);
+
+    TRY(chain.render(image1, offset1, "Hello"));
+    TRY(s_serif.render(image2, offset2, "Hello"));
+    TEST_EQUAL(offset1, offset2);
+    TEST(image1 == image2);
+
+    TRY(map.search(fonts_dir));
+    TRY(fonts = map.find_chain({"DejaVu Serif"}, "Hello"));
+    TEST_EQUAL(fonts.size(), 1u);
+    TRY(fonts = map.find_chain({"DejaVu Serif"}, "Hello " + euro_currency));
+    TEST_EQUAL(fonts.size(), 2u);
+    if (fonts.size() == 2) {
+        TEST_EQUAL(fonts[0].family(), "DejaVu Serif");
+        TEST_EQUAL(fonts[1].family(), "DejaVu Sans Mono");
+    }
+
+}
+
+void test_rs_graphics_2d_font_batch_rendering() {
+
+    static const std::vector<std::string> words = {"Hello", "world", "Goodbye", "\u20a0\u20a1", "Line 1\nLine 2", ""};
+    static const std::vector<Rgbaf> colours = {Rgbaf::black(), Rgbaf::red(), Rgbaf(0, 0.5, 1, 0.5)};
+
+    Font mono, serif;
+    std::vector<ScaledFont> fonts;
+    std::vector<TextLabel<Rgbaf>> labels;
+    HdrImage image1({300, 200}, Rgbaf::clear());
+    HdrImage image2({300, 200}, Rgbaf::clear());
+    PmaHdrImage pma_image1({300, 200}, Rgbaf::clear());
+    PmaHdrImage pma_image2({300, 200}, Rgbaf::clear());
+
+    TRY(mono = Font(mono_file));
+    TRY(serif = Font(serif_file));
+    TRY(fonts.push_back(ScaledFont(mono, 15)));
+    TRY(fonts.push_back(ScaledFont(serif, 24, FontRender::subpixel)));
+    TRY(fonts.push_back(ScaledFont({serif, mono}, 12)));
+
+    for (int i = 0; i < 500; ++i) {
+        TextLabel<Rgbaf> label;
+        label.font = fonts[i % fonts.size()];
+        label.ref_point = {(i * 37) % 320 - 20, (i * 53) % 230 - 10};
+        label.text = words[i % words.size()];
+        label.colour = colours[i % colours.size()];
+        label.line_shift = i % 4 == 0 ? - label.font.line_offset() : 0; // Overlapping lines
+        labels.push_back(label);
+    }
+
+    for (auto& label: labels) {
+        TRY(label.font.render_to(image1, label.ref_point, label.text, label.line_shift, label.colour));
+        TRY(label.font.render_to(pma_image1, label.ref_point, label.text, label.line_shift, label.colour));
+    }
+
+    TRY(render_batch(image2, labels));
+    TRY(render_batch(pma_image2, labels));
+    TEST(image1 == image2);
+    TEST(pma_image1 == pma_image2);
+
+    labels[10].font = {};
+    TEST_THROW(render_batch(image2, labels), std::invalid_argument);
+
+}
+
 void test_rs_graphics_2d_font_map() {
 
     FontMap map;
@@ -373,3 +748,255 @@ void test_rs_graphics_2d_font_map() {
     TEST_MATCH(font.name(), "^(Helvetica|Arial|DejaVu Sans) Bold$");
 
 }
+
+void test_rs_graphics_2d_font_map_parallel_search() {
+
+    // Files are parsed in parallel, but the map should come out the same as
+    // a sequential scan, where the last file in directory order wins when
+    // two files contain the same face
+
+    const std::string temp_dir = "font-parallel.tmp";
+    const std::vector<std::string> sources = {mono_file, serif_file, ttc_file};
+
+    FontMap map;
+    Font font;
+    std::vector<Font> fonts;
+    std::map<std::string, std::map<std::string, std::string>> expect;
+    std::vector<std::string> families, subfamilies;
+    std::error_code ec;
+
+    std::filesystem::remove_all(temp_dir, ec);
+    std::filesystem::create_directory(temp_dir, ec);
+    for (size_t i = 0; i < 24; ++i)
+        copy_file(sources[i % 3], temp_dir + "/font-" + std::to_string(i) + (i % 3 == 2 ? ".ttc" : ".ttf"));
+
+    for (auto& file: Path(temp_dir).directory()) {
+        TRY(fonts = Font::load(file));
+        for (auto& f: fonts)
+            expect[f.family()][f.subfamily()] = file.name();
+    }
+    TEST_EQUAL(expect.size(), 2u);
+
+    TRY(map.search(temp_dir));
+    TEST_EQUAL(map.size(), expect.size());
+    TRY(families = map.families());
+    TEST_EQUAL(families.size(), expect.size());
+
+    for (auto& [family, inner]: expect) {
+        TEST(std::find(families.begin(), families.end(), family) != families.end());
+        TRY(subfamilies = map.subfamilies(family));
+        TEST_EQUAL(subfamilies.size(), inner.size());
+        for (auto& [subfamily, file]: inner) {
+            TEST(std::find(subfamilies.begin(), subfamilies.end(), subfamily) != subfamilies.end());
+            TRY(font = map.load(family, subfamily));
+            TEST(font);
+            TEST_EQUAL(FontProbe(font).content(), FontProbe(Font(file)).content());
+        }
+    }
+
+    TRY(font = {});
+    TRY(FontMap::clear_cache());
+    std::filesystem::remove_all(temp_dir, ec);
+
+}
+
+void test_rs_graphics_2d_font_map_cache() {
+
+    FontMap map;
+    Font font1, font2;
+
+    TRY(map.search(fonts_dir));
+    TEST(map.contains("DejaVu Sans Mono", "Book"));
+    TEST(map.contains("DejaVu Serif", "Book"));
+
+    TRY(font1 = map.load("DejaVu Sans Mono", "Book"));
+    TEST(font1);
+    TEST_EQUAL(font1.name(), "DejaVu Sans Mono");
+    TRY(font2 = map.load("DejaVu Sans Mono", "Book"));
+    TEST(font2);
+    TEST_EQUAL(font2.name(), "DejaVu Sans Mono");
+
+    TRY(FontMap::set_cache_limit(0));
+    TRY(font1 = map.find({"DejaVu Serif"}));
+    TEST(font1);
+    TEST_EQUAL(font1.name(), "DejaVu Serif");
+    TRY(font2 = map.load("DejaVu Sans Mono", "Book"));
+    TEST(font2);
+    TEST_EQUAL(font2.name(), "DejaVu Sans Mono");
+
+    TRY(FontMap::clear_cache());
+    TEST(font1);
+    TEST(font1.has_glyph(U'A'));
+    TRY(FontMap::set_cache_limit(256ul << 20));
+
+    // A cached font is served until a search finds its file was replaced
+
+    const std::string temp_dir = "font-cache.tmp";
+    const std::string temp_file = temp_dir + "/font.ttf";
+    const std::string temp_file_2 = temp_dir + "/font.new";
+    FontMap temp_map;
+    std::error_code ec;
+
+    std::filesystem::remove_all(temp_dir, ec);
+    std::filesystem::create_directory(temp_dir, ec);
+    copy_file(mono_file, temp_file);
+    TRY(temp_map.search(temp_dir));
+    TEST(temp_map.contains("DejaVu Sans Mono", "Book"));
+    TRY(font1 = temp_map.load("DejaVu Sans Mono", "Book"));
+    TEST_EQUAL(font1.name(), "DejaVu Sans Mono");
+
+    copy_file(serif_file, temp_file_2);
+    std::remove(temp_file.data());
+    TEST_EQUAL(std::rename(temp_file_2.data(), temp_file.data()), 0);
+    TRY(font2 = temp_map.load("DejaVu Sans Mono", "Book"));
+    TEST_EQUAL(font2.name(), "DejaVu Sans Mono");
+    TEST_EQUAL(FontProbe(font2).content(), FontProbe(font1).content());
+
+    TRY(temp_map.search(temp_dir));
+    TEST(temp_map.contains("DejaVu Serif", "Book"));
+    TRY(font2 = temp_map.load("DejaVu Sans Mono", "Book"));
+    TEST_EQUAL(font2.name(), "DejaVu Serif");
+    TEST_EQUAL(font1.name(), "DejaVu Sans Mono");
+
+    TRY(FontMap::clear_cache());
+    std::filesystem::remove_all(temp_dir, ec);
+
+}
+
+void test_rs_graphics_2d_font_map_collection() {
+
+    // A collection whose first face can't be loaded should still map the
+    // second face to its real index in the file
+
+    const std::string temp_dir = "font-collection.tmp";
+    const std::string temp_file = temp_dir + "/fonts.ttc";
+
+    FontMap map;
+    Font font;
+    std::vector<Font> fonts;
+    std::string content;
+    size_t record = 0;
+    std::error_code ec;
+
+    TRY(fonts = Font::load(ttc_file));
+    TEST_EQUAL(fonts.size(), 2u);
+    TRY(content = read_file(ttc_file));
+    TRY(record = find_table_record(content, get_be32(content, 12), "cmap"));
+    TEST(record != 0);
+    content[record] = 'x'; // Hide the first face's cmap
+
+    std::filesystem::remove_all(temp_dir, ec);
+    std::filesystem::create_directory(temp_dir, ec);
+    TRY(write_file(temp_file, content));
+
+    TRY(font = Font(temp_file, 0));
+    TEST(! font);
+    TRY(font = Font(temp_file, 1));
+    TEST(font);
+    TEST_EQUAL(font.name(), fonts[1].name());
+
+    TRY(map.search(temp_dir));
+    TEST_EQUAL(map.size(), 1u);
+    TRY(font = map.load(fonts[1].family(), fonts[1].subfamily()));
+    TEST(font);
+    TEST_EQUAL(font.name(), fonts[1].name());
+
+    TRY(FontMap::clear_cache());
+    std::filesystem::remove_all(temp_dir, ec);
+
+}
+
+void test_rs_graphics_2d_font_map_bad_cmap() {
+
+    // A cmap subtable whose group count runs far past the end of the file
+    // must not be walked
+
+    const std::string temp_dir = "font-bad-cmap.tmp";
+    const std::string temp_file = temp_dir + "/bad-cmap.ttf";
+
+    FontMap map;
+    Font font;
+    std::vector<std::string> families;
+    std::error_code ec;
+
+    std::filesystem::remove_all(temp_dir, ec);
+    std::filesystem::create_directory(temp_dir, ec);
+    TRY(write_bad_cmap_font(mono_file, temp_file));
+
+    TRY(font = Font(temp_file));
+    TEST(font);
+    TRY(map.search(temp_dir));
+    TEST_EQUAL(map.size(), 1u);
+    TRY(families = map.families_covering("Hello"));
+    TEST(families.empty());
+
+    TRY(FontMap::clear_cache());
+    std::filesystem::remove_all(temp_dir, ec);
+
+}
+
+void test_rs_graphics_2d_font_map_index() {
+
+    const std::string index_file = "font-index.tmp";
+
+    FontMap map1, map2, map3;
+    std::vector<std::string> families1, families2, families3;
+    Font font;
+    std::string content, marker;
+    size_t pos = 0, num_files = 0;
+
+    auto get_u32 = [&content, &pos] {
+        uint32_t n = 0;
+        if (pos + 4 <= content.size())
+            std::memcpy(&n, content.data() + pos, 4);
+        pos += 4;
+        return size_t(n);
+    };
+
+    std::remove(index_file.data());
+
+    TRY(map1.search_system());
+    TRY(families1 = map1.families());
+    TRY(map2.search_system(index_file));
+    TRY(families2 = map2.families());
+
+    TEST(! families1.empty());
+    TEST(families2 == families1);
+    TEST(std::filesystem::exists(index_file));
+
+    TRY(font = map2.find({"Helvetica", "Arial", "DejaVu Sans"}));
+    TEST(font);
+    TEST_MATCH(font.name(), "^(Helvetica|Arial|DejaVu Sans)$");
+
+    // Rename the first face recorded in the index, keeping the length of the
+    // name. The files are unchanged, so a search using the index should
+    // take the face from the index record.
+
+    TRY(content = read_file(index_file));
+    REQUIRE(content.size() > 16);
+    REQUIRE(content.compare(0, 8, "RSFONTIX") == 0);
+    pos = 12;
+    num_files = get_u32();
+
+    for (size_t i = 0; i < num_files && marker.empty() && pos < content.size(); ++i) {
+        pos += get_u32(); // File name
+        pos += 16; // Modification time and size
+        if (get_u32() == 0)
+            continue;
+        pos += 4; // Face index
+        size_t len = get_u32();
+        REQUIRE(len > 0 && pos + len <= content.size());
+        marker.assign(len, 'Q');
+        content.replace(pos, len, marker);
+    }
+
+    REQUIRE(! marker.empty());
+    TRY(write_file(index_file, content));
+    TRY(map3.search_system(index_file));
+    TRY(families3 = map3.families());
+    TEST(std::find(families3.begin(), families3.end(), marker) != families3.end());
+    TEST(std::find(families1.begin(), families1.end(), marker) == families1.end());
+
+    std::remove(index_file.data());
+
+}
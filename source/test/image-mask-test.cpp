@@ -0,0 +1,279 @@
+#include "rs-graphics-2d/image-mask.hpp"
+#include "rs-graphics-2d/image.hpp"
+#include "rs-graphics-core/colour.hpp"
+#include "rs-graphics-core/geometry.hpp"
+#include "rs-unit-test.hpp"
+#include "test/vector-test.hpp"
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+using namespace RS::Graphics::Core;
+using namespace RS::Graphics::Plane;
+using namespace RS::Graphics::Plane::Detail;
+
+namespace {
+
+    using BottomUpImage8 = Image<Rgba8, ImageFlags::bottom_up>;
+    using BottomUpHdrImage = Image<Rgbaf, ImageFlags::bottom_up>;
+
+    const Point mask_shape = {37, 23};
+
+    // Reference result for one pixel, blending the foreground at the
+    // mask's coverage over the background
+
+    template <typename C, typename T>
+    C blend_pixel(C fg, C bg, T value, bool premultiplied) {
+        using value_type = typename C::value_type;
+        double a = double(value) / double(ImageMask<T>::scale) * double(fg.alpha());
+        if constexpr (std::is_floating_point_v<value_type>)
+            fg.alpha() = value_type(a);
+        else
+            fg.alpha() = value_type(a + 0.5);
+        return alpha_blend(fg, bg, premultiplied ? Pma::result : Pma::none);
+    }
+
+    ByteMask make_byte_mask() {
+        ByteMask mask(mask_shape);
+        for (int y = 0; y < mask_shape.y(); ++y)
+            for (int x = 0; x < mask_shape.x(); ++x)
+                mask[{x, y}] = (unsigned char)((7 * x + 13 * y) % 256);
+        return mask;
+    }
+
+    HdrMask make_hdr_mask() {
+        HdrMask mask(mask_shape);
+        for (int y = 0; y < mask_shape.y(); ++y)
+            for (int x = 0; x < mask_shape.x(); ++x)
+                mask[{x, y}] = float((7 * x + 13 * y) % 101) / 100.0f;
+        return mask;
+    }
+
+    // Clear diagonal bands of a mask, so its sparse form has several spans
+    // per row with gaps between them
+
+    template <typename T>
+    void clear_bands(ImageMask<T>& mask) {
+        for (int y = 0; y < mask.shape().y(); ++y)
+            for (int x = 0; x < mask.shape().x(); ++x)
+                if ((x + 2 * y) % 9 < 4)
+                    mask[{x, y}] = 0;
+    }
+
+    // Compare each pixel of an image made from a mask with the reference
+    // blend of the mask value at the same position. Images are written in
+    // memory order whatever their orientation.
+
+    template <typename T, typename C, ImageFlags F>
+    void check_mask_image(const ImageMask<T>& mask, const Image<C, F>& image, C fg, C bg, double epsilon) {
+        REQUIRE(image.shape() == mask.shape());
+        for (int y = 0; y < mask.shape().y(); ++y) {
+            for (int x = 0; x < mask.shape().x(); ++x) {
+                auto expect = blend_pixel(fg, bg, mask[{x, y}], Image<C, F>::is_premultiplied);
+                TEST_VECTORS(image(x, y), expect, epsilon);
+            }
+        }
+    }
+
+}
+
+void test_rs_graphics_2d_image_mask_byte_image() {
+
+    const Rgba8 fg(200, 100, 50, 220);
+    const Rgba8 bg(10, 20, 30, 128);
+    const Rgba8 opaque_bg(10, 20, 30);
+
+    auto mask = make_byte_mask();
+    Image8 image;
+    PmaImage8 pma_image;
+    BottomUpImage8 bottom_up_image;
+
+    TRY(mask.make_image(image, fg, bg));
+    check_mask_image(mask, image, fg, bg, 0);
+    TRY(mask.make_image(image, fg, opaque_bg));
+    check_mask_image(mask, image, fg, opaque_bg, 0);
+    TRY(mask.make_image(pma_image, fg, bg));
+    check_mask_image(mask, pma_image, fg, bg, 0);
+    TRY(mask.make_image(bottom_up_image, fg, bg));
+    check_mask_image(mask, bottom_up_image, fg, bg, 0);
+
+}
+
+void test_rs_graphics_2d_image_mask_hdr_image() {
+
+    const Rgba8 fg8(200, 100, 50, 220);
+    const Rgba8 bg8(10, 20, 30, 128);
+    const Rgbaf fg(0.8f, 0.4f, 0.2f, 0.9f);
+    const Rgbaf bg(0.05f, 0.1f, 0.15f, 0.5f);
+
+    auto mask = make_hdr_mask();
+    Image8 image8;
+    PmaImage8 pma_image8;
+    BottomUpImage8 bottom_up_image8;
+    HdrImage image;
+    PmaHdrImage pma_image;
+    BottomUpHdrImage bottom_up_image;
+
+    TRY(mask.make_image(image8, fg8, bg8));
+    check_mask_image(mask, image8, fg8, bg8, 1);
+    TRY(mask.make_image(pma_image8, fg8, bg8));
+    check_mask_image(mask, pma_image8, fg8, bg8, 1);
+    TRY(mask.make_image(bottom_up_image8, fg8, bg8));
+    check_mask_image(mask, bottom_up_image8, fg8, bg8, 1);
+
+    TRY(mask.make_image(image, fg, bg));
+    check_mask_image(mask, image, fg, bg, 1e-5);
+    TRY(mask.make_image(pma_image, fg, bg));
+    check_mask_image(mask, pma_image, fg, bg, 1e-5);
+    TRY(mask.make_image(bottom_up_image, fg, bg));
+    check_mask_image(mask, bottom_up_image, fg, bg, 1e-5);
+
+}
+
+void test_rs_graphics_2d_image_mask_sparse_rows() {
+
+    const unsigned char row[] = {0, 1, 2, 0, 0, 3, 0, 0, 0, 0};
+    const unsigned char part1[] = {0, 4, 5};
+    const unsigned char part2[] = {6, 7, 0, 8};
+    const unsigned char part3[] = {9, 10};
+    const Rgba8 fg(200, 100, 50);
+    const Rgba8 bg(10, 20, 30);
+
+    SparseByteMask mask(Point(10, 3));
+    ByteMask dense(Point(10, 3));
+    Image8 image, dense_image;
+
+    TEST_EQUAL(mask.spans(), 0u);
+    TEST_EQUAL(mask.covered(), 0u);
+
+    TRY(mask.append_row(0, 0, row, 10));
+    TEST_EQUAL(mask.spans(), 2u);
+    TEST_EQUAL(mask.covered(), 3u);
+
+    // Parts of a row that meet are merged into one span
+
+    TRY(mask.append_row(1, 0, part1, 3));
+    TEST_EQUAL(mask.spans(), 3u);
+    TRY(mask.append_row(1, 3, part2, 4));
+    TEST_EQUAL(mask.spans(), 4u);
+    TEST_EQUAL(mask.covered(), 8u);
+    TRY(mask.append_row(1, 7, part3, 2));
+    TEST_EQUAL(mask.spans(), 4u);
+    TEST_EQUAL(mask.covered(), 10u);
+
+    // A span at the start of a row never joins the previous row
+
+    TRY(mask.append_row(2, 0, part3, 2));
+    TEST_EQUAL(mask.spans(), 5u);
+    TEST_EQUAL(mask.covered(), 12u);
+
+    for (int x = 0; x < 10; ++x)
+        dense[{x, 0}] = row[x];
+    for (int x = 0; x < 9; ++x)
+        dense[{x, 1}] = (unsigned char)(x < 3 ? part1[x] : x < 7 ? part2[x - 3] : part3[x - 7]);
+    dense[{0, 2}] = part3[0];
+    dense[{1, 2}] = part3[1];
+
+    TRY(mask.make_image(image, fg, bg));
+    TRY(dense.make_image(dense_image, fg, bg));
+    TEST(image == dense_image);
+
+}
+
+void test_rs_graphics_2d_image_mask_sparse_image() {
+
+    const Rgba8 fg8(200, 100, 50, 220);
+    const Rgba8 bg8(10, 20, 30, 128);
+    const Rgbaf fg(0.8f, 0.4f, 0.2f, 0.9f);
+    const Rgbaf bg(0.05f, 0.1f, 0.15f, 0.5f);
+
+    auto dense8 = make_byte_mask();
+    auto dense = make_hdr_mask();
+    clear_bands(dense8);
+    clear_bands(dense);
+    SparseMask<unsigned char> mask8(dense8);
+    SparseMask<float> mask(dense);
+
+    TEST_EQUAL(mask8.shape(), dense8.shape());
+    TEST_EQUAL(size_t(std::count(dense8.begin(), dense8.end(), 0)), dense8.area() - mask8.covered());
+    TEST_EQUAL(size_t(std::count(dense.begin(), dense.end(), 0.0f)), dense.area() - mask.covered());
+    TEST(mask8.spans() > size_t(mask_shape.y()));
+
+    // Pixels outside the spans take the background colour
+
+    Image8 image8, dense_image8;
+    PmaImage8 pma_image8, dense_pma_image8;
+    HdrImage image, dense_image;
+
+    TRY(mask8.make_image(image8, fg8, bg8));
+    TRY(dense8.make_image(dense_image8, fg8, bg8));
+    TEST(image8 == dense_image8);
+    TEST_EQUAL(image8(0, 0), bg8);
+
+    TRY(mask8.make_image(pma_image8, fg8, bg8));
+    TRY(dense8.make_image(dense_pma_image8, fg8, bg8));
+    TEST(pma_image8 == dense_pma_image8);
+
+    TRY(mask.make_image(image, fg, bg));
+    TRY(dense.make_image(dense_image, fg, bg));
+    TEST(image == dense_image);
+
+}
+
+void test_rs_graphics_2d_image_mask_sparse_clipping() {
+
+    const Rgba8 colour8(200, 100, 50, 220);
+    const Rgba8 base_colour8(10, 20, 30, 128);
+    const Rgbaf colour(0.8f, 0.4f, 0.2f, 0.9f);
+    const Rgbaf base_colour(0.05f, 0.1f, 0.15f, 0.5f);
+    const Point image_shape(50, 40);
+
+    const std::vector<Point> offsets = {
+        {0, 0}, {5, 7}, {-6, -4}, {20, 25}, {45, 2}, {60, 60},
+    };
+
+    const std::vector<Box_i2> clips = {
+        {{0, 0}, image_shape},
+        {{8, 5}, {12, 4}},
+        {{-5, -5}, {17, 100}},
+        {{10, 10}, {1, 1}},
+        {{30, 20}, {0, 5}},
+    };
+
+    auto dense8 = make_byte_mask();
+    auto dense = make_hdr_mask();
+    clear_bands(dense8);
+    clear_bands(dense);
+    SparseMask<unsigned char> mask8(dense8);
+    SparseMask<float> mask(dense);
+
+    Image8 base8(image_shape, base_colour8), image8, dense_image8;
+    HdrImage base(image_shape, base_colour), image, dense_image;
+
+    for (auto offset: offsets) {
+        for (auto& clip: clips) {
+
+            image8 = dense_image8 = base8;
+            TRY(mask8.onto_image(image8, offset, colour8, clip));
+            TRY(dense8.onto_image(dense_image8, offset, colour8, clip));
+            TEST(image8 == dense_image8);
+
+            image = dense_image = base;
+            TRY(mask.onto_image(image, offset, colour, clip));
+            TRY(dense.onto_image(dense_image, offset, colour, clip));
+            TEST(image == dense_image);
+
+        }
+    }
+
+    // A clip box that cuts through spans leaves everything outside it alone
+
+    image8 = base8;
+    TRY(mask8.onto_image(image8, {2, 3}, colour8, clips[1]));
+    TEST(image8 != base8);
+    for (int y = 0; y < image_shape.y(); ++y)
+        for (int x = 0; x < image_shape.x(); ++x)
+            if (x < 8 || x >= 20 || y < 5 || y >= 9)
+                TEST_EQUAL(image8(x, y), base_colour8);
+
+}
@@ -0,0 +1,85 @@
+#include "rs-graphics-2d/image-pyramid.hpp"
+#include "rs-graphics-2d/image.hpp"
+#include "rs-graphics-core/colour.hpp"
+#include "rs-unit-test.hpp"
+#include "test/vector-test.hpp"
+
+using namespace RS::Graphics::Core;
+using namespace RS::Graphics::Plane;
+
+void test_rs_graphics_2d_image_pyramid_levels() {
+
+    ImagePyramid<Rgba8> pyramid;
+    Image8 image;
+
+    TEST(pyramid.empty());
+    TEST_EQUAL(pyramid.size(), 0u);
+
+    TRY(image.reset({256, 128}, Rgba8(10, 20, 30, 40)));
+    TRY(pyramid.build(image));
+    REQUIRE(pyramid.size() == 9u);
+    TEST(pyramid[0] == image);
+
+    int w = 256, h = 128;
+
+    for (auto& level: pyramid) {
+        TEST_EQUAL(level.width(), w);
+        TEST_EQUAL(level.height(), h);
+        TEST_VECTORS(level(0, 0), Rgba8(10, 20, 30, 40), 1);
+        TEST_VECTORS(level(w - 1, h - 1), Rgba8(10, 20, 30, 40), 1);
+        w = std::max(w / 2, 1);
+        h = std::max(h / 2, 1);
+    }
+
+    TRY(image.reset({5, 3}, Rgba8::red()));
+    TRY(pyramid.build(image, ImageResize::parallel));
+    REQUIRE(pyramid.size() == 4u);
+    TEST_EQUAL(pyramid[1].shape(), Point(3, 2));
+    TEST_EQUAL(pyramid[2].shape(), Point(2, 1));
+    TEST_EQUAL(pyramid[3].shape(), Point(1, 1));
+    TEST_VECTORS(pyramid[3](0, 0), Rgba8::red(), 1);
+
+    TRY(image.clear());
+    TRY(pyramid.build(image));
+    TEST(pyramid.empty());
+
+}
+
+void test_rs_graphics_2d_image_pyramid_content() {
+
+    // A one pixel checkerboard averages to half intensity in linear light
+
+    sImage8 image(64, 64);
+
+    for (int y = 0; y < 64; ++y)
+        for (int x = 0; x < 64; ++x)
+            image(x, y) = (x + y) % 2 == 0 ? sRgba8::black() : sRgba8::white();
+
+    ImagePyramid<sRgba8> pyramid(image);
+    REQUIRE(pyramid.size() == 7u);
+
+    sRgba8 grey;
+    convert_colour(Rgbaf(0.5f, 0.5f, 0.5f, 1), grey);
+
+    for (size_t i = 1; i < pyramid.size(); ++i)
+        for (int y = 0; y < pyramid[i].height(); ++y)
+            for (int x = 0; x < pyramid[i].width(); ++x)
+                TEST_VECTORS(pyramid[i](x, y), grey, 1);
+
+    // Transparent pixels don't contribute their colour
+
+    PmaHdrImage pma(2, 2, Rgbaf::clear());
+    pma(0, 0) = Rgbaf::red();
+
+    ImagePyramid<Rgbaf, ImageFlags::premultiplied> pma_pyramid(pma);
+    REQUIRE(pma_pyramid.size() == 2u);
+    TEST_VECTORS(pma_pyramid[1](0, 0), Rgbaf(0.25f, 0, 0, 0.25f), 1e-6);
+
+    HdrImage straight(2, 2, Rgbaf::clear());
+    straight(0, 0) = Rgbaf::red();
+
+    ImagePyramid<Rgbaf> straight_pyramid(straight);
+    REQUIRE(straight_pyramid.size() == 2u);
+    TEST_VECTORS(straight_pyramid[1](0, 0), Rgbaf(1, 0, 0, 0.25f), 1e-6);
+
+}
@@ -83,3 +83,244 @@ void test_rs_graphics_2d_image_resize_content() {
     // TODO
 
 }
+
+void test_rs_graphics_2d_image_resize_parallel() {
+
+    Image8 in8, serial8, parallel8;
+    sImage16 in16, serial16, parallel16;
+    PmaHdrImage in32, serial32, parallel32;
+
+    TRY(in8.reset({300, 200}));
+    TRY(in16.reset({300, 200}));
+    TRY(in32.reset({300, 200}));
+
+    for (int y = 0; y < 200; ++y) {
+        for (int x = 0; x < 300; ++x) {
+            in8(x, y) = Rgba8(uint8_t(x), uint8_t(y), uint8_t(x ^ y), uint8_t(255 - x / 2));
+            in16(x, y) = sRgba16(uint16_t(x * 200), uint16_t(y * 300), uint16_t((x * y) % 65536), 65535);
+            in32(x, y) = Rgbaf(float(x) / 300, float(y) / 200, 0.5f, 1).multiply_alpha();
+        }
+    }
+
+    for (auto shape: {Point(97, 61), Point(600, 400), Point(300, 1000)}) {
+
+        TRY(serial8 = in8.resized(shape, ImageResize::unlock));
+        TRY(parallel8 = in8.resized(shape, ImageResize::unlock | ImageResize::parallel));
+        TEST(parallel8 == serial8);
+
+        TRY(serial16 = in16.resized(shape, ImageResize::unlock | ImageResize::wrap));
+        TRY(parallel16 = in16.resized(shape, ImageResize::unlock | ImageResize::wrap | ImageResize::parallel));
+        TEST(parallel16 == serial16);
+
+        TRY(serial32 = in32.resized(shape, ImageResize::unlock));
+        TRY(parallel32 = in32.resized(shape, ImageResize::unlock | ImageResize::parallel));
+        TEST(parallel32 == serial32);
+
+    }
+
+}
+
+void test_rs_graphics_2d_image_resize_into() {
+
+    Image8 in8, expect8, out8;
+    sImage16 in16, expect16, out16;
+    PmaHdrImage in32, expect32, out32;
+    ResizeContext context;
+
+    TEST_EQUAL(context.bytes(), 0u);
+
+    TRY(in8.reset({300, 200}));
+    TRY(in16.reset({300, 200}));
+    TRY(in32.reset({300, 200}));
+
+    for (int y = 0; y < 200; ++y) {
+        for (int x = 0; x < 300; ++x) {
+            in8(x, y) = Rgba8(uint8_t(x), uint8_t(y), uint8_t(x ^ y), uint8_t(255 - x / 2));
+            in16(x, y) = sRgba16(uint16_t(x * 200), uint16_t(y * 300), uint16_t((x * y) % 65536), 65535);
+            in32(x, y) = Rgbaf(float(x) / 300, float(y) / 200, 0.5f, 1).multiply_alpha();
+        }
+    }
+
+    for (auto shape: {Point(97, 61), Point(600, 400), Point(150, 100)}) {
+
+        TRY(expect8 = in8.resized(shape, ImageResize::unlock));
+        TRY(out8.reset(shape));
+        auto ptr = out8.data();
+        TRY(resize_into(in8, out8, context));
+        TEST(out8 == expect8);
+        TEST(out8.data() == ptr);
+        TEST(context.bytes() > 0);
+
+        TRY(expect16 = in16.resized(shape, ImageResize::unlock | ImageResize::wrap));
+        TRY(out16.reset(shape));
+        TRY(resize_into(in16, out16, context, ImageResize::wrap));
+        TEST(out16 == expect16);
+
+        TRY(expect32 = in32.resized(shape, ImageResize::unlock));
+        TRY(out32.reset(shape));
+        TRY(resize_into(in32, out32, context, ImageResize::parallel));
+        TEST(out32 == expect32);
+
+    }
+
+    TRY(context.clear());
+    TEST_EQUAL(context.bytes(), 0u);
+
+    Image8 empty;
+
+    TEST_THROW(resize_into(empty, out8, context), std::invalid_argument);
+    TEST_THROW(resize_into(in8, empty, context), std::invalid_argument);
+
+}
+
+void test_rs_graphics_2d_image_resize_filters() {
+
+    static const std::vector<ImageFilter> filters = {
+        ImageFilter::automatic,
+        ImageFilter::box,
+        ImageFilter::triangle,
+        ImageFilter::bspline,
+        ImageFilter::catmull_rom,
+        ImageFilter::mitchell,
+        ImageFilter::lanczos3,
+    };
+
+    Image8 in8, out8;
+    sImage8 in8s, out8s;
+    PmaHdrImage in32, out32;
+
+    TRY(in8.reset({60, 40}, Rgba8(100, 150, 200, 250)));
+    TRY(in8s.reset({60, 40}, sRgba8(100, 150, 200, 250)));
+    TRY(in32.reset({60, 40}, Rgbaf(0.2f, 0.4f, 0.6f, 0.8f).multiply_alpha()));
+
+    // A uniform image stays uniform with any filter
+
+    for (auto filter: filters) {
+        for (auto shape: {Point(25, 15), Point(150, 90), Point(25, 90)}) {
+
+            TRY(out8 = in8.resized(shape, ImageResize::unlock, filter));
+            REQUIRE(out8.shape() == shape);
+            TEST_VECTORS(out8(0, 0), Rgba8(100, 150, 200, 250), 1);
+            TEST_VECTORS(out8(12, 7), Rgba8(100, 150, 200, 250), 1);
+            TEST_VECTORS(out8(24, 14), Rgba8(100, 150, 200, 250), 1);
+
+            TRY(out8s = in8s.resized(shape, ImageResize::unlock, filter));
+            REQUIRE(out8s.shape() == shape);
+            TEST_VECTORS(out8s(12, 7), sRgba8(100, 150, 200, 250), 1);
+
+            TRY(out32 = in32.resized(shape, ImageResize::unlock | ImageResize::wrap, filter));
+            REQUIRE(out32.shape() == shape);
+            TEST_VECTORS(out32(12, 7), Rgbaf(0.2f, 0.4f, 0.6f, 0.8f).multiply_alpha(), 1e-5);
+
+        }
+    }
+
+    // Different filters give different results on a sharp edge
+
+    for (int y = 0; y < 40; ++y)
+        for (int x = 0; x < 60; ++x)
+            in32(x, y) = x < 30 ? Rgbaf::black() : Rgbaf::white();
+
+    PmaHdrImage box, cubic, lanczos, mixed;
+
+    TRY(box = in32.resized({240, 160}, ImageResize::none, ImageFilter::box));
+    TRY(cubic = in32.resized({240, 160}, ImageResize::none, ImageFilter::catmull_rom));
+    TRY(lanczos = in32.resized({240, 160}, ImageResize::none, ImageFilter::lanczos3));
+    TRY(mixed = in32.resized({240, 160}, ImageResize::none, {ImageFilter::box, ImageFilter::lanczos3}));
+
+    TEST(box != cubic);
+    TEST(box != lanczos);
+    TEST(cubic != lanczos);
+    TEST(mixed == box);
+
+    TEST_VECTORS(lanczos(0, 80), Rgbaf::black(), 1e-5);
+    TEST_VECTORS(lanczos(239, 80), Rgbaf::white(), 1e-5);
+    TEST(lanczos(119, 80)[0] < 0.5);
+    TEST(lanczos(120, 80)[0] > 0.5);
+    TEST_NEAR(lanczos(119, 80).alpha(), 1, 1e-5);
+
+    // Filter weights are cached in the context and reused
+
+    ResizeContext context;
+    PmaHdrImage out1(150, 100), out2(150, 100);
+
+    TRY(resize_into(in32, out1, context, ImageResize::none, ImageFilter::lanczos3));
+    size_t bytes = context.bytes();
+    TEST(bytes > 0);
+    TRY(resize_into(in32, out2, context, ImageResize::parallel, ImageFilter::lanczos3));
+    TEST_EQUAL(context.bytes(), bytes);
+    TEST(out1 == out2);
+
+}
+
+void test_rs_graphics_2d_image_resize_integer_ratio() {
+
+    // Exact reductions average each block of pixels
+
+    Image8 in8(8, 6), out8;
+
+    for (int y = 0; y < 6; ++y)
+        for (int x = 0; x < 8; ++x)
+            in8(x, y) = Rgba8(uint8_t(x * 10), uint8_t(y * 20), uint8_t(x * y), 255);
+
+    TRY(out8 = in8.resized({4, 3}));
+    REQUIRE(out8.shape() == Point(4, 3));
+    TEST_VECTORS(out8(0, 0), Rgba8(5, 10, 0, 255), 1);
+    TEST_VECTORS(out8(3, 2), Rgba8(65, 90, 30, 255), 1);
+
+    TRY(out8 = in8.resized({2, 3}, ImageResize::unlock));
+    REQUIRE(out8.shape() == Point(2, 3));
+    TEST_VECTORS(out8(1, 1), Rgba8(55, 50, 14, 255), 1);
+
+    TRY(out8 = in8.resized({8, 6}));
+    TEST(out8 == in8);
+
+    // sRGB values are averaged in linear light
+
+    sImage8 in8s(4, 4), out8s;
+    sRgba8 grey;
+    convert_colour(Rgbaf(0.5f, 0.5f, 0.5f, 1), grey);
+
+    for (int y = 0; y < 4; ++y)
+        for (int x = 0; x < 4; ++x)
+            in8s(x, y) = (x + y) % 2 == 0 ? sRgba8::black() : sRgba8::white();
+
+    TRY(out8s = in8s.resized({2, 2}));
+    REQUIRE(out8s.shape() == Point(2, 2));
+    TEST_VECTORS(out8s(0, 0), grey, 1);
+    TEST_VECTORS(out8s(1, 1), grey, 1);
+
+    // Colour is weighted by alpha unless already premultiplied
+
+    HdrImage in32(2, 1), out32;
+    in32(0, 0) = Rgbaf(1, 0, 0, 0);
+    in32(1, 0) = Rgbaf(0, 0, 1, 1);
+
+    TRY(out32 = in32.resized({1, 1}, ImageResize::unlock));
+    REQUIRE(out32.shape() == Point(1, 1));
+    TEST_VECTORS(out32(0, 0), Rgbaf(0, 0, 1, 0.5f), 1e-6);
+
+    PmaImage16 in16(2, 2, Rgba16(1000, 2000, 3000, 4000)), out16;
+    in16(1, 1) = Rgba16(3000, 4000, 5000, 6000);
+
+    TRY(out16 = in16.resized({1, 1}, ImageResize::unlock));
+    REQUIRE(out16.shape() == Point(1, 1));
+    TEST_VECTORS(out16(0, 0), Rgba16(1500, 2500, 3500, 4500), 1);
+
+    // Block sums of 8 bit data overflow 32 bits for very large blocks
+
+    PmaImage8 big8(4200, 4200, Rgba8(200, 100, 50, 255)), small8;
+
+    TRY(small8 = big8.resized({1, 1}));
+    REQUIRE(small8.shape() == Point(1, 1));
+    TEST_EQUAL(small8(0, 0), Rgba8(200, 100, 50, 255));
+
+    // Column sums of 8 bit data overflow 32 bits for very tall blocks
+
+    PmaImage8 tall8(1, 16'843'010, Rgba8(200, 100, 50, 255));
+
+    TRY(small8 = tall8.resized({1, 1}, ImageResize::unlock));
+    REQUIRE(small8.shape() == Point(1, 1));
+    TEST_VECTORS(small8(0, 0), Rgba8(200, 100, 50, 255), 1);
+
+}
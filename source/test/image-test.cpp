@@ -2,7 +2,10 @@
 #include "rs-graphics-core/colour.hpp"
 #include "rs-unit-test.hpp"
 #include "test/vector-test.hpp"
+#include <algorithm>
+#include <iterator>
 #include <stdexcept>
+#include <type_traits>
 
 using namespace RS::Graphics::Core;
 using namespace RS::Graphics::Plane;
@@ -133,6 +136,106 @@ void test_rs_graphics_2d_image_premultiplied_alpha() {
 
 }
 
+void test_rs_graphics_2d_image_premultiplied_alpha_in_place() {
+
+    Image8 rgb1, rgb2;
+    Image16 rgb3, rgb4;
+    HdrImage hdr1, hdr2;
+    PmaImage8 prgb1, prgb2;
+    PmaImage16 prgb3, prgb4;
+    PmaHdrImage phdr1, phdr2;
+    const Rgba8* ptr8 = nullptr;
+    const Rgba16* ptr16 = nullptr;
+    const Rgbaf* ptrf = nullptr;
+    int errors = 0;
+
+    TRY(rgb1.reset(256, 256));
+    for (int y = 0; y < 256; ++y)
+        for (int x = 0; x < 256; ++x)
+            rgb1(x, y) = Rgba8(uint8_t(x), uint8_t(255 - x), uint8_t(x / 2), uint8_t(y));
+
+    TRY(prgb1 = rgb1.multiply_alpha());
+    errors = 0;
+    for (int y = 0; y < 256; ++y)
+        for (int x = 0; x < 256; ++x)
+            if (prgb1(x, y) != rgb1(x, y).multiply_alpha())
+                ++errors;
+    TEST_EQUAL(errors, 0);
+
+    // Unmultiply rounds exact halves up
+
+    TRY(rgb2 = prgb1.unmultiply_alpha());
+    errors = 0;
+    for (int y = 0; y < 256; ++y) {
+        for (int x = 0; x < 256; ++x) {
+            auto pc = prgb1(x, y);
+            for (int c = 0; c < 3; ++c) {
+                int expect = y == 0 ? 0 : std::min((510 * pc[c] + y) / (2 * y), 255);
+                if (rgb2(x, y)[c] != expect)
+                    ++errors;
+            }
+            if (rgb2(x, y)[3] != y)
+                ++errors;
+        }
+    }
+    TEST_EQUAL(errors, 0);
+
+    rgb2 = rgb1;
+    ptr8 = &*rgb2.begin();
+    TRY(prgb2 = std::move(rgb2).multiply_alpha());
+    TEST(rgb2.empty());
+    TEST_EQUAL(&*prgb2.begin(), ptr8);
+    TEST(prgb2 == prgb1);
+    TRY(rgb2 = std::move(prgb2).unmultiply_alpha());
+    TEST(prgb2.empty());
+    TEST_EQUAL(&*rgb2.begin(), ptr8);
+    TEST(rgb2 == prgb1.unmultiply_alpha());
+
+    TRY(rgb3.reset(64, 64));
+    for (int y = 0; y < 64; ++y)
+        for (int x = 0; x < 64; ++x)
+            rgb3(x, y) = Rgba16(uint16_t(1041 * x), uint16_t(65535 - 1041 * x), uint16_t(997 * y), uint16_t(1040 * y + 13 * x));
+
+    TRY(prgb3 = rgb3.multiply_alpha());
+    TRY(rgb4 = prgb3.unmultiply_alpha());
+    errors = 0;
+    for (int y = 0; y < 64; ++y)
+        for (int x = 0; x < 64; ++x)
+            if (prgb3(x, y) != rgb3(x, y).multiply_alpha())
+                ++errors;
+    TEST_EQUAL(errors, 0);
+    for (int y = 0; y < 64; y += 7)
+        for (int x = 0; x < 64; x += 7)
+            TEST_VECTORS(rgb4(x, y), prgb3(x, y).unmultiply_alpha(), 1);
+
+    ptr16 = &*rgb3.begin();
+    TRY(prgb4 = std::move(rgb3).multiply_alpha());
+    TEST(rgb3.empty());
+    TEST_EQUAL(&*prgb4.begin(), ptr16);
+    TEST(prgb4 == prgb3);
+
+    TRY(hdr1.reset(100, 100));
+    for (int y = 0; y < 100; ++y)
+        for (int x = 0; x < 100; ++x)
+            hdr1(x, y) = Rgbaf(float(x) / 100, float(y) / 100, 0.5f, float(x + y) / 200);
+
+    TRY(phdr1 = hdr1.multiply_alpha());
+    TRY(hdr2 = phdr1.unmultiply_alpha());
+    for (int y = 0; y < 100; y += 9) {
+        for (int x = 0; x < 100; x += 9) {
+            TEST_VECTORS(phdr1(x, y), hdr1(x, y).multiply_alpha(), 1e-6);
+            TEST_VECTORS(hdr2(x, y), phdr1(x, y).unmultiply_alpha(), 1e-6);
+        }
+    }
+
+    ptrf = &*hdr1.begin();
+    TRY(phdr2 = std::move(hdr1).multiply_alpha());
+    TEST(hdr1.empty());
+    TEST_EQUAL(&*phdr2.begin(), ptrf);
+    TEST(phdr2 == phdr1);
+
+}
+
 void test_rs_graphics_2d_image_conversion() {
 
     static const Rgba8 bc1 = {50,100,150,200};
@@ -199,3 +302,260 @@ void test_rs_graphics_2d_image_conversion() {
     TEST_VECTORS(*phdr.bottom_right(),  fc2, 1e-5);
 
 }
+
+void test_rs_graphics_2d_image_conversion_pipeline() {
+
+    Image8 rgb1, rgb2;
+    HdrImage hdr1, hdr2;
+    PmaImage8 prgb1, prgb2;
+    PmaHdrImage phdr1, phdr2;
+    Image<Rgba8, ImageFlags::bottom_up> burgb;
+    Image<Rgbaf, ImageFlags::bottom_up | ImageFlags::premultiplied> bphdr;
+    const Rgbaf* ptr = nullptr;
+
+    TRY(rgb1.reset(30, 20));
+    for (int y = 0; y < 20; ++y)
+        for (int x = 0; x < 30; ++x)
+            rgb1(x, y) = Rgba8(uint8_t(8 * x), uint8_t(12 * y), uint8_t(100), uint8_t(50 + 10 * y));
+
+    TRY(convert_image(rgb1, burgb));
+    TEST_EQUAL(burgb.shape(), rgb1.shape());
+    TEST_VECTORS(*burgb.top_left(),      *rgb1.top_left(),      0);
+    TEST_VECTORS(*burgb.top_right(),     *rgb1.top_right(),     0);
+    TEST_VECTORS(*burgb.bottom_left(),   *rgb1.bottom_left(),   0);
+    TEST_VECTORS(*burgb.bottom_right(),  *rgb1.bottom_right(),  0);
+    TEST_VECTORS(burgb(5, 0),            rgb1(5, 19),           0);
+    TEST_VECTORS(burgb(5, 19),           rgb1(5, 0),            0);
+
+    TRY(convert_image(burgb, rgb2));
+    TEST(rgb2 == rgb1);
+
+    TRY(prgb1 = rgb1.multiply_alpha());
+    TRY(convert_image(prgb1.unmultiply_alpha(), hdr1));
+    TRY(phdr1 = hdr1.multiply_alpha());
+
+    TRY(convert_image(prgb1, phdr2));
+    TEST_EQUAL(phdr2.shape(), prgb1.shape());
+    for (int y = 0; y < 20; y += 3)
+        for (int x = 0; x < 30; x += 3)
+            TEST_VECTORS(phdr2(x, y), phdr1(x, y), 1e-6);
+
+    TRY(convert_image(prgb1, bphdr));
+    TEST_VECTORS(*bphdr.top_left(),      *phdr1.top_left(),      1e-6);
+    TEST_VECTORS(*bphdr.bottom_right(),  *phdr1.bottom_right(),  1e-6);
+
+    TRY(convert_image(phdr2, prgb2));
+    TEST(prgb2 == prgb1);
+
+    ptr = &phdr2(0, 0);
+    TRY(convert_image(prgb1, phdr2));
+    TEST_EQUAL(&phdr2(0, 0), ptr);
+
+    TRY(convert_image(HdrImage(), phdr2));
+    TEST(phdr2.empty());
+
+}
+
+void test_rs_graphics_2d_image_conversion_in_place() {
+
+    Image8 rgb1, rgb2;
+    PmaImage8 prgb1, prgb2;
+    Image<Rgba8, ImageFlags::bottom_up> burgb1, burgb2;
+    Image<Rgba8, ImageFlags::bottom_up | ImageFlags::premultiplied> bprgb1, bprgb2;
+    HdrImage hdr1, hdr2;
+    const Rgba8* ptr = nullptr;
+
+    TRY(rgb1.reset(25, 15));
+    for (int y = 0; y < 15; ++y)
+        for (int x = 0; x < 25; ++x)
+            rgb1(x, y) = Rgba8(uint8_t(10 * x), uint8_t(17 * y), uint8_t(x + y), uint8_t(255 - 9 * y));
+
+    TRY(convert_image(rgb1, burgb1));
+    TRY(convert_image(rgb1, prgb1));
+    TRY(convert_image(rgb1, bprgb1));
+    TRY(convert_image(rgb1, hdr1));
+
+    rgb2 = rgb1;
+    ptr = &rgb2(0, 0);
+    TRY(convert_image(std::move(rgb2), burgb2));
+    TEST(rgb2.empty());
+    TEST_EQUAL(&burgb2(0, 0), ptr);
+    TEST(burgb2 == burgb1);
+    TEST_VECTORS(*burgb2.top_left(), *rgb1.top_left(), 0);
+    TEST_VECTORS(burgb2(3, 7), rgb1(3, 7), 0);
+
+    TRY(convert_image(std::move(burgb2), rgb2));
+    TEST(burgb2.empty());
+    TEST_EQUAL(&rgb2(0, 0), ptr);
+    TEST(rgb2 == rgb1);
+
+    TRY(convert_image(std::move(rgb2), prgb2));
+    TEST_EQUAL(&prgb2(0, 0), ptr);
+    TEST(prgb2 == prgb1);
+
+    TRY(convert_image(std::move(prgb2), bprgb2));
+    TEST_EQUAL(&bprgb2(0, 0), ptr);
+    TEST(bprgb2 == bprgb1);
+
+    rgb2 = rgb1;
+    TRY(convert_image(std::move(rgb2), bprgb2));
+    TEST(bprgb2 == bprgb1);
+
+    rgb2 = rgb1;
+    TRY(convert_image(std::move(rgb2), hdr2));
+    TEST(rgb2.empty());
+    TEST(hdr2 == hdr1);
+
+}
+
+void test_rs_graphics_2d_image_fill() {
+
+    static const Rgba8 bc1 = {50,100,150,200};
+    static const Rgba8 bc2 = {0,0,0,0};
+    static const Rgba8 bc3 = {255,255,255,255};
+    static const Rgbaf fc1 = {0.2,0.4,0.6,0.8};
+
+    Image8 rgb;
+    HdrImage hdr;
+    int errors = 0;
+
+    TRY(rgb.reset(40, 30, bc1));
+    for (auto& pixel: rgb)
+        if (pixel != bc1)
+            ++errors;
+    TEST_EQUAL(errors, 0);
+
+    TRY(rgb.fill(bc2));
+    errors = 0;
+    for (auto& pixel: rgb)
+        if (pixel != bc2)
+            ++errors;
+    TEST_EQUAL(errors, 0);
+
+    TRY(rgb.fill(Box_i2({5, 10}, {20, 8}), bc3));
+    errors = 0;
+    for (int y = 0; y < 30; ++y)
+        for (int x = 0; x < 40; ++x)
+            if (rgb(x, y) != (x >= 5 && x < 25 && y >= 10 && y < 18 ? bc3 : bc2))
+                ++errors;
+    TEST_EQUAL(errors, 0);
+
+    TRY(rgb.fill(Box_i2({-10, 25}, {100, 100}), bc1));
+    errors = 0;
+    for (int y = 25; y < 30; ++y)
+        for (int x = 0; x < 40; ++x)
+            if (rgb(x, y) != bc1)
+                ++errors;
+    TEST_EQUAL(errors, 0);
+    TEST_VECTORS(rgb(0, 24), bc2, 0);
+
+    TRY(rgb.fill(Box_i2({30, -5}, {50, 10}), bc1));
+    TEST_VECTORS(rgb(29, 0), bc2, 0);
+    TEST_VECTORS(rgb(30, 0), bc1, 0);
+    TEST_VECTORS(rgb(39, 4), bc1, 0);
+    TEST_VECTORS(rgb(39, 5), bc2, 0);
+
+    TRY(rgb.fill(Box_i2({50, 50}, {10, 10}), bc3));
+    TRY(rgb.fill(Box_i2({10, 10}, {0, 10}), bc3));
+    TEST_VECTORS(rgb(10, 10), bc3, 0);
+    TEST_VECTORS(rgb(4, 12), bc2, 0);
+
+    TRY(hdr.reset(20, 20, fc1));
+    TEST_VECTORS(hdr(0, 0), fc1, 0);
+    TEST_VECTORS(hdr(19, 19), fc1, 0);
+    TRY(hdr.fill(Rgbaf()));
+    TEST_VECTORS(hdr(0, 0), Rgbaf(0, 0, 0, 0), 0);
+    TEST_VECTORS(hdr(19, 19), Rgbaf(0, 0, 0, 0), 0);
+
+    // Filling an empty image is a no-op
+
+    TRY(rgb.reset({0, 0}, bc2));
+    TEST(rgb.empty());
+    TRY(rgb.fill(bc1));
+    TRY(rgb.fill(bc3));
+    TRY(rgb.fill(Box_i2({0, 0}, {10, 10}), bc3));
+    TEST(rgb.empty());
+
+}
+
+void test_rs_graphics_2d_image_random_access() {
+
+    using iterator_category = std::iterator_traits<Image8::iterator>::iterator_category;
+    using value_type = std::iterator_traits<Image8::const_iterator>::value_type;
+
+    static_assert(std::is_same_v<iterator_category, std::random_access_iterator_tag>);
+    static_assert(std::is_same_v<value_type, Rgba8>);
+
+    Image8 rgb1, rgb2;
+    Image8::iterator i, j;
+    Image8::const_iterator k;
+    int errors = 0;
+
+    TRY(rgb1.reset(20, 10));
+    for (int y = 0; y < 10; ++y)
+        for (int x = 0; x < 20; ++x)
+            rgb1(x, y) = Rgba8(uint8_t(x), uint8_t(y), uint8_t(x + y), 255);
+
+    TRY(i = rgb1.begin());
+    TEST_EQUAL(rgb1.end() - i, 200);
+    TEST_EQUAL(std::distance(i, rgb1.end()), 200);
+
+    TRY(j = i + 45);
+    TEST_EQUAL(j.pos(), Point(5, 2));
+    TEST_EQUAL(j - i, 45);
+    TEST(i < j);
+    TEST(j > i);
+    TEST(i <= i);
+    TEST(j >= i);
+    TEST_VECTORS(*j, rgb1(5, 2), 0);
+    TEST_VECTORS(i[45], rgb1(5, 2), 0);
+    TEST_VECTORS(j[-20], rgb1(5, 1), 0);
+    TRY(j -= 21);
+    TEST_EQUAL(j.pos(), Point(4, 1));
+    TRY(j += 40);
+    TEST_EQUAL(j.pos(), Point(4, 3));
+    TRY(j = 3 + j);
+    TEST_EQUAL(j.pos(), Point(7, 3));
+    TRY(j = j - 7);
+    TEST_EQUAL(j.pos(), Point(0, 3));
+
+    TRY(k = rgb1.locate(19, 9));
+    TEST(k == rgb1.end() - 1);
+    TEST_EQUAL(&k[0], &*k);
+    TEST_EQUAL(&k[-199], &*rgb1.begin());
+
+    // Mutable and const iterators compare in either order
+
+    TRY(j = rgb1.end() - 1);
+    TEST(j == k);
+    TEST(k == j);
+    TEST(! (j != k));
+    TEST(! (k != j));
+    TRY(j = rgb1.begin());
+    TEST(j != k);
+    TEST(k != j);
+    TEST(j < k);
+    TEST(k > j);
+    TEST(j <= k);
+    TEST(k >= j);
+    TEST(! (k < j));
+    TEST(! (j > k));
+    TEST_EQUAL(k - j, 199);
+    TEST_EQUAL(j - k, -199);
+
+    TRY(rgb2.reset(rgb1.shape()));
+    TRY(std::transform(rgb1.begin(), rgb1.end(), rgb2.begin(), [] (const Rgba8& c) {
+        return Rgba8(c[1], c[0], c[2], c[3]);
+    }));
+    errors = 0;
+    for (int y = 0; y < 10; ++y)
+        for (int x = 0; x < 20; ++x)
+            if (rgb2(x, y) != Rgba8(uint8_t(y), uint8_t(x), uint8_t(x + y), 255))
+                ++errors;
+    TEST_EQUAL(errors, 0);
+
+    TRY(std::reverse(rgb2.begin(), rgb2.end()));
+    TEST_VECTORS(rgb2(0, 0), Rgba8(9, 19, 28, 255), 0);
+    TEST_VECTORS(rgb2(19, 9), Rgba8(0, 0, 0, 255), 0);
+
+}
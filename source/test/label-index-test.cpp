@@ -0,0 +1,98 @@
+#include "rs-graphics-2d/label-index.hpp"
+#include "rs-graphics-2d/font.hpp"
+#include "rs-graphics-core/geometry.hpp"
+#include "rs-unit-test.hpp"
+#include <string>
+#include <vector>
+
+using namespace RS::Graphics::Core;
+using namespace RS::Graphics::Plane;
+
+namespace {
+
+    const std::string fonts_dir = "../source/test/fonts/";
+    const std::string serif_file = fonts_dir + "DejaVuSerif.ttf";
+
+}
+
+void test_rs_graphics_2d_label_index_boxes() {
+
+    LabelIndex index;
+
+    TEST(index.empty());
+    TEST_EQUAL(index.cell_size(), 64);
+    TEST(! index.collides(Box_i2({0, 0}, {10, 10})));
+
+    TEST(index.insert(Box_i2({0, 0}, {10, 10})));
+    TEST_EQUAL(index.size(), 1u);
+    TEST(index.collides(Box_i2({5, 5}, {10, 10})));
+    TEST(index.collides(Box_i2({-5, -5}, {6, 6})));
+    TEST(! index.collides(Box_i2({10, 0}, {10, 10})));
+    TEST(! index.collides(Box_i2({0, 10}, {10, 10})));
+    TEST(! index.collides(Box_i2({-10, -10}, {10, 10})));
+    TEST(! index.collides(Box_i2({5, 5}, {0, 10})));
+
+    TEST(! index.insert(Box_i2({9, 9}, {100, 100})));
+    TEST_EQUAL(index.size(), 1u);
+    TEST(index.insert(Box_i2({10, 10}, {200, 100})));
+    TEST_EQUAL(index.size(), 2u);
+    TEST(index.collides(Box_i2({150, 100}, {1, 1})));
+    TEST(index.collides(Box_i2({-1000, 50}, {2000, 1})));
+    TEST(! index.collides(Box_i2({210, 10}, {1, 1})));
+
+    TEST(index.insert(Box_i2({-100, -100}, {20, 20})));
+    TEST(index.collides(Box_i2({-90, -90}, {1, 1})));
+    TEST(! index.collides(Box_i2({-80, -80}, {1, 1})));
+
+    TRY(index.add(Box_i2({-90, -90}, {1, 1})));
+    TEST_EQUAL(index.size(), 4u);
+    TEST_EQUAL(index.boxes().size(), 4u);
+
+    TRY(index.clear());
+    TEST(index.empty());
+    TEST(! index.collides(Box_i2({5, 5}, {10, 10})));
+
+    TEST_THROW(LabelIndex(0), std::invalid_argument);
+
+}
+
+void test_rs_graphics_2d_label_index_text() {
+
+    Font font;
+    ScaledFont sfont;
+    LabelIndex index(16);
+    Box_i2 box;
+    int placed = 0;
+
+    TRY(font = Font(serif_file));
+    TRY(sfont = ScaledFont(font, 20));
+    TRY(box = sfont.text_box("Hello"));
+
+    TEST(index.insert_text(sfont, {100, 100}, "Hello"));
+    TEST_EQUAL(index.size(), 1u);
+    TEST_EQUAL(index.boxes()[0], Box_i2(box.base() + Point{100, 100}, box.shape()));
+    TEST(! index.insert_text(sfont, {110, 105}, "Hello"));
+    TEST(index.insert_text(sfont, {100, 100 + box.shape().y() + 2}, "Hello"));
+    TEST(! index.insert_text(sfont, {100, 100 + 2 * box.shape().y() + 4}, "Hello", 0, 5));
+    TEST(index.insert_text(sfont, {100, 100}, ""));
+    TEST_EQUAL(index.size(), 2u);
+    TEST_THROW(index.insert_text(ScaledFont(), {100, 100}, "Hello"), std::invalid_argument);
+
+    TRY(index.clear());
+
+    for (int y = 0; y < 500; y += 7)
+        for (int x = 0; x < 500; x += 11)
+            if (index.insert_text(sfont, {x, y}, "Hello"))
+                ++placed;
+
+    TEST_EQUAL(size_t(placed), index.size());
+    TEST(placed > 10);
+
+    for (size_t i = 0; i < index.boxes().size(); ++i)
+        for (size_t j = i + 1; j < index.boxes().size(); ++j)
+            TEST(! (index.boxes()[i].base().x() < index.boxes()[j].apex().x()
+                && index.boxes()[j].base().x() < index.boxes()[i].apex().x()
+                && index.boxes()[i].base().y() < index.boxes()[j].apex().y()
+                && index.boxes()[j].base().y() < index.boxes()[i].apex().y()));
+
+}
@@ -13,26 +13,63 @@ int main(int argc, char** argv) {
     UNIT_TEST(rs_graphics_2d_image_construction)
     UNIT_TEST(rs_graphics_2d_image_pixel_access)
     UNIT_TEST(rs_graphics_2d_image_premultiplied_alpha)
+    UNIT_TEST(rs_graphics_2d_image_premultiplied_alpha_in_place)
     UNIT_TEST(rs_graphics_2d_image_conversion)
+    UNIT_TEST(rs_graphics_2d_image_conversion_pipeline)
+    UNIT_TEST(rs_graphics_2d_image_conversion_in_place)
+    UNIT_TEST(rs_graphics_2d_image_fill)
+    UNIT_TEST(rs_graphics_2d_image_random_access)
 
     // image-io-test.cpp
     UNIT_TEST(rs_graphics_2d_image_io_file_info)
     UNIT_TEST(rs_graphics_2d_image_io_load)
     UNIT_TEST(rs_graphics_2d_image_io_save)
 
+    // image-pyramid-test.cpp
+    UNIT_TEST(rs_graphics_2d_image_pyramid_levels)
+    UNIT_TEST(rs_graphics_2d_image_pyramid_content)
+
     // image-resize-test.cpp
     UNIT_TEST(rs_graphics_2d_image_resize_dimensions)
     UNIT_TEST(rs_graphics_2d_image_resize_content)
+    UNIT_TEST(rs_graphics_2d_image_resize_parallel)
+    UNIT_TEST(rs_graphics_2d_image_resize_into)
+    UNIT_TEST(rs_graphics_2d_image_resize_filters)
+    UNIT_TEST(rs_graphics_2d_image_resize_integer_ratio)
+
+    // image-mask-test.cpp
+    UNIT_TEST(rs_graphics_2d_image_mask_byte_image)
+    UNIT_TEST(rs_graphics_2d_image_mask_hdr_image)
+    UNIT_TEST(rs_graphics_2d_image_mask_sparse_rows)
+    UNIT_TEST(rs_graphics_2d_image_mask_sparse_image)
+    UNIT_TEST(rs_graphics_2d_image_mask_sparse_clipping)
 
     // font-test.cpp
     UNIT_TEST(rs_graphics_2d_font_loading)
+    UNIT_TEST(rs_graphics_2d_font_file_sharing)
     UNIT_TEST(rs_graphics_2d_font_properties)
+    UNIT_TEST(rs_graphics_2d_font_coverage)
+    UNIT_TEST(rs_graphics_2d_font_coverage_bad_cmap)
     UNIT_TEST(rs_graphics_2d_font_metrics)
     UNIT_TEST(rs_graphics_2d_font_text_metrics)
     UNIT_TEST(rs_graphics_2d_font_text_fitting)
     UNIT_TEST(rs_graphics_2d_font_text_wrapping)
     UNIT_TEST(rs_graphics_2d_font_rendering)
+    UNIT_TEST(rs_graphics_2d_font_blending)
+    UNIT_TEST(rs_graphics_2d_font_subpixel_rendering)
+    UNIT_TEST(rs_graphics_2d_font_sdf_rendering)
+    UNIT_TEST(rs_graphics_2d_font_fallback)
+    UNIT_TEST(rs_graphics_2d_font_batch_rendering)
     UNIT_TEST(rs_graphics_2d_font_map)
+    UNIT_TEST(rs_graphics_2d_font_map_parallel_search)
+    UNIT_TEST(rs_graphics_2d_font_map_cache)
+    UNIT_TEST(rs_graphics_2d_font_map_collection)
+    UNIT_TEST(rs_graphics_2d_font_map_bad_cmap)
+    UNIT_TEST(rs_graphics_2d_font_map_index)
+
+    // label-index-test.cpp
+    UNIT_TEST(rs_graphics_2d_label_index_boxes)
+    UNIT_TEST(rs_graphics_2d_label_index_text)
 
     // projection-test.cpp
     UNIT_TEST(rs_graphics_2d_projection_polar_coordinate_normalisation)